@@ -4,8 +4,16 @@
 
 
 #include <Eigen/Core>
+#include "halfedge_mesh.h"
 
+// Collapses interior non-feature edges shorter than the average low of their
+// endpoints into their midpoint, shortest first. Collapses that would stretch
+// an edge beyond high, flip a face or break the manifold are skipped.
 void collapse_edges(Eigen::MatrixXd & V,Eigen::MatrixXi & F, Eigen::VectorXi & feature, Eigen::VectorXd & high, Eigen::VectorXd & low);
 
+// Same as above, in place; deleted elements are only dropped on export.
+// Returns the number of collapses.
+int collapse_edges(HalfedgeMesh & mesh);
+
 
 #endif
@@ -4,8 +4,16 @@
 
 
 #include <Eigen/Core>
+#include "halfedge_mesh.h"
 
+// Flips interior edges whose four vertices are not features when that brings
+// the valences closer to six, unless it would fold the surface.
 void equalize_valences(Eigen::MatrixXd & V,Eigen::MatrixXi & F, Eigen::VectorXi & feature);
 
+// Same as above, in place. With more than one thread the flips are applied in
+// rounds of edges with vertex-disjoint neighbourhoods, each round in parallel.
+// Returns the number of flips.
+int equalize_valences(HalfedgeMesh & mesh, int num_threads = 1);
+
 
 #endif
@@ -0,0 +1,334 @@
+#include "halfedge_mesh.h"
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+std::vector<char> feature_mask(const Eigen::VectorXi & feature, int n){
+    std::vector<char> is_feature(n,0);
+    for (int s = 0; s < feature.size(); s++) {
+        is_feature[feature(s)] = 1;
+    }
+    return is_feature;
+}
+
+}
+
+HalfedgeMesh::HalfedgeMesh(const Eigen::MatrixXd & V, const Eigen::MatrixXi & F,
+        const Eigen::VectorXi & feature, const Eigen::VectorXd & high,
+        const Eigen::VectorXd & low)
+    : HalfedgeMesh(V,F,feature_mask(feature,V.rows()),high,low){
+}
+
+HalfedgeMesh::HalfedgeMesh(const Eigen::MatrixXd & V, const Eigen::MatrixXi & F,
+        const std::vector<char> & is_feature, const Eigen::VectorXd & high,
+        const Eigen::VectorXd & low){
+    const int n = V.rows();
+    const int m = F.rows();
+
+    m_position.resize(n);
+    m_high.resize(n);
+    m_low.resize(n);
+    m_is_feature.assign(n,0);
+    m_is_deleted.assign(n,0);
+    m_out.assign(n,-1);
+    for (int i = 0; i < n; i++) {
+        m_position[i] = V.row(i).transpose();
+        m_high[i] = high(i);
+        m_low[i] = low(i);
+        m_is_feature[i] = is_feature[i] != 0;
+    }
+
+    m_corner.resize(3*m);
+    m_twin.assign(3*m,-1);
+    for (int f = 0; f < m; f++) {
+        for (int i = 0; i < 3; i++) {
+            m_corner[3*f+i] = F(f,i);
+            m_out[F(f,i)] = 3*f+i;
+        }
+    }
+
+    // Group halfedges by their undirected edge and pair the ones of manifold
+    // edges, i.e. exactly two halfedges with opposite orientations
+    std::vector<std::pair<std::pair<int,int>,int>> keyed(3*m);
+    for (int h = 0; h < 3*m; h++) {
+        const int a = from(h);
+        const int b = to(h);
+        keyed[h] = std::make_pair(std::make_pair(std::min(a,b),std::max(a,b)),h);
+    }
+    std::sort(keyed.begin(),keyed.end());
+    for (int i = 0; i < 3*m; ) {
+        int j = i+1;
+        while (j < 3*m && keyed[j].first == keyed[i].first) {
+            j++;
+        }
+        if (j-i == 2) {
+            const int h = keyed[i].second;
+            const int t = keyed[i+1].second;
+            if (from(h) == to(t)) {
+                set_twin(h,t);
+            }
+        }
+        i = j;
+    }
+}
+
+void HalfedgeMesh::export_to(Eigen::MatrixXd & V, Eigen::MatrixXi & F,
+        Eigen::VectorXi & feature, Eigen::VectorXd & high,
+        Eigen::VectorXd & low) const{
+    std::vector<char> is_feature;
+    export_to(V,F,is_feature,high,low);
+    int num_features = 0;
+    for (char f : is_feature) {
+        num_features += f;
+    }
+    feature.resize(num_features);
+    int s = 0;
+    for (int i = 0; i < (int)is_feature.size(); i++) {
+        if (is_feature[i]) {
+            feature(s++) = i;
+        }
+    }
+}
+
+void HalfedgeMesh::export_to(Eigen::MatrixXd & V, Eigen::MatrixXi & F,
+        std::vector<char> & is_feature, Eigen::VectorXd & high,
+        Eigen::VectorXd & low) const{
+    const int n = num_vertices();
+    const int m = num_faces();
+
+    std::vector<int> new_index(n,-1);
+    int num_live_vertices = 0;
+    for (int v = 0; v < n; v++) {
+        if (!m_is_deleted[v]) {
+            new_index[v] = num_live_vertices++;
+        }
+    }
+    int num_live_faces = 0;
+    for (int f = 0; f < m; f++) {
+        num_live_faces += !is_face_deleted(f);
+    }
+
+    V.resize(num_live_vertices,3);
+    high.resize(num_live_vertices);
+    low.resize(num_live_vertices);
+    is_feature.assign(num_live_vertices,0);
+    for (int v = 0; v < n; v++) {
+        const int i = new_index[v];
+        if (i < 0) {
+            continue;
+        }
+        V.row(i) = m_position[v].transpose();
+        high(i) = m_high[v];
+        low(i) = m_low[v];
+        is_feature[i] = m_is_feature[v];
+    }
+
+    F.resize(num_live_faces,3);
+    int k = 0;
+    for (int f = 0; f < m; f++) {
+        if (is_face_deleted(f)) {
+            continue;
+        }
+        for (int i = 0; i < 3; i++) {
+            F(k,i) = new_index[m_corner[3*f+i]];
+        }
+        k++;
+    }
+}
+
+void HalfedgeMesh::export_to(Eigen::MatrixXd & V, Eigen::MatrixXi & F) const{
+    std::vector<char> feature;
+    Eigen::VectorXd high,low;
+    export_to(V,F,feature,high,low);
+}
+
+bool HalfedgeMesh::is_boundary_vertex(int v) const{
+    bool boundary = false;
+    for_each_outgoing(v,[&](int h){
+        if (m_twin[h] < 0 || m_twin[prev(h)] < 0) {
+            boundary = true;
+        }
+    });
+    return boundary;
+}
+
+int HalfedgeMesh::valence(int v) const{
+    int count = 0;
+    for_each_outgoing(v,[&](int){ count++; });
+    return count;
+}
+
+int HalfedgeMesh::split_edge(int h){
+    const int mid = add_vertices(1);
+    split_edge(h,mid,add_faces(2));
+    return mid;
+}
+
+void HalfedgeMesh::split_edge(int h, int mid, int f){
+    const int t = m_twin[h];
+    const int a = from(h);
+    const int b = to(h);
+    const int c = opposite(h);
+    const int d = opposite(t);
+    const int hn = next(h);
+    const int tn = next(t);
+    const int hn_twin = m_twin[hn];
+    const int tn_twin = m_twin[tn];
+
+    m_position[mid] = 0.5*(m_position[a]+m_position[b]);
+    m_high[mid] = 0.5*(m_high[a]+m_high[b]);
+    m_low[mid] = 0.5*(m_low[a]+m_low[b]);
+
+    // (a,b,c) -> (a,m,c) + (m,b,c) and (b,a,d) -> (b,m,d) + (m,a,d)
+    const int g = 3*f;
+    const int k = 3*(f+1);
+    m_corner[hn] = mid;
+    m_corner[tn] = mid;
+    m_corner[g] = mid;
+    m_corner[g+1] = b;
+    m_corner[g+2] = c;
+    m_corner[k] = mid;
+    m_corner[k+1] = a;
+    m_corner[k+2] = d;
+
+    set_twin(h,k);
+    set_twin(t,g);
+    set_twin(hn,g+2);
+    set_twin(g+1,hn_twin);
+    set_twin(tn,k+2);
+    set_twin(k+1,tn_twin);
+
+    m_out[mid] = g;
+    if (m_out[b] == hn) {
+        m_out[b] = g+1;
+    }
+    if (m_out[a] == tn) {
+        m_out[a] = k+1;
+    }
+}
+
+int HalfedgeMesh::add_vertices(int count){
+    const int first = m_position.size();
+    m_position.resize(first+count,Eigen::Vector3d::Zero());
+    m_high.resize(first+count,0);
+    m_low.resize(first+count,0);
+    m_is_feature.resize(first+count,0);
+    m_is_deleted.resize(first+count,0);
+    m_out.resize(first+count,-1);
+    return first;
+}
+
+int HalfedgeMesh::add_faces(int count){
+    const int first = m_corner.size()/3;
+    m_corner.resize(3*(first+count),-1);
+    m_twin.resize(3*(first+count),-1);
+    return first;
+}
+
+bool HalfedgeMesh::is_collapse_ok(int h) const{
+    const int t = m_twin[h];
+    if (t < 0) {
+        return false;
+    }
+    const int a = from(h);
+    const int b = to(h);
+    const int c = opposite(h);
+    const int d = opposite(t);
+    if (c == d || is_boundary_vertex(a) || is_boundary_vertex(b)) {
+        return false;
+    }
+    if (valence(a)+valence(b)-4 < 3 || valence(c) <= 3 || valence(d) <= 3) {
+        return false;
+    }
+
+    // One-rings are small, so a linear scan beats any set
+    std::vector<int> ring_a;
+    for_each_outgoing(a,[&](int g){ ring_a.push_back(to(g)); });
+    bool ok = true;
+    for_each_outgoing(b,[&](int g){
+        const int v = to(g);
+        if (v != c && v != d && std::find(ring_a.begin(),ring_a.end(),v) != ring_a.end()) {
+            ok = false;
+        }
+    });
+    return ok;
+}
+
+void HalfedgeMesh::collapse_edge(int h, const Eigen::Vector3d & p){
+    const int t = m_twin[h];
+    const int a = from(h);
+    const int b = to(h);
+    const int c = opposite(h);
+    const int d = opposite(t);
+    // Outer halfedges of the two faces that get glued together
+    const int bc_twin = m_twin[next(h)];
+    const int ca_twin = m_twin[prev(h)];
+    const int ad_twin = m_twin[next(t)];
+    const int db_twin = m_twin[prev(t)];
+
+    std::vector<int> from_b;
+    for_each_outgoing(b,[&](int g){ from_b.push_back(g); });
+    for (int g : from_b) {
+        m_corner[g] = a;
+    }
+
+    for (int f : {face(h),face(t)}) {
+        for (int i = 0; i < 3; i++) {
+            m_corner[3*f+i] = -1;
+            m_twin[3*f+i] = -1;
+        }
+    }
+    set_twin(bc_twin,ca_twin);
+    set_twin(ad_twin,db_twin);
+
+    m_out[a] = ca_twin;
+    m_out[c] = bc_twin;
+    m_out[d] = ad_twin;
+    m_out[b] = -1;
+    m_is_deleted[b] = 1;
+    m_position[a] = p;
+}
+
+int HalfedgeMesh::flip_edge(int h){
+    const int t = m_twin[h];
+    const int a = from(h);
+    const int b = to(h);
+    const int c = opposite(h);
+    const int d = opposite(t);
+    const int bc_twin = m_twin[next(h)];
+    const int ca_twin = m_twin[prev(h)];
+    const int ad_twin = m_twin[next(t)];
+    const int db_twin = m_twin[prev(t)];
+
+    // (a,b,c) -> (d,c,a) and (b,a,d) -> (c,d,b)
+    const int g = 3*face(h);
+    const int k = 3*face(t);
+    m_corner[g] = d;
+    m_corner[g+1] = c;
+    m_corner[g+2] = a;
+    m_corner[k] = c;
+    m_corner[k+1] = d;
+    m_corner[k+2] = b;
+
+    set_twin(g,k);
+    set_twin(g+1,ca_twin);
+    set_twin(g+2,ad_twin);
+    set_twin(k+1,db_twin);
+    set_twin(k+2,bc_twin);
+
+    m_out[a] = g+2;
+    m_out[b] = k+2;
+    m_out[c] = k;
+    m_out[d] = g;
+    return g;
+}
+
+void HalfedgeMesh::set_twin(int h, int t){
+    if (h >= 0) {
+        m_twin[h] = t;
+    }
+    if (t >= 0) {
+        m_twin[t] = h;
+    }
+}
@@ -0,0 +1,144 @@
+#ifndef HALFEDGE_MESH
+#define HALFEDGE_MESH
+
+
+
+#include <Eigen/Core>
+#include <vector>
+
+// Mutable triangle mesh the remeshing stages edit in place.
+//
+// Faces are stored as a corner table: halfedge h = 3*f+i runs from corner i
+// of face f to corner (i+1)%3, so next/prev/face are index arithmetic and
+// only the twin of every halfedge is stored (-1 on the boundary). Edges with
+// more than two incident faces are left unpaired and hence treated as
+// boundary, so no operation ever touches them.
+//
+// Deleted faces and vertices are tombstoned; indices of live elements never
+// change until the mesh is exported, which compacts them in order.
+class HalfedgeMesh
+{
+public:
+    HalfedgeMesh(const Eigen::MatrixXd & V, const Eigen::MatrixXi & F,
+            const Eigen::VectorXi & feature, const Eigen::VectorXd & high,
+            const Eigen::VectorXd & low);
+    // Same as above, with is_feature(v) != 0 for the feature vertices
+    HalfedgeMesh(const Eigen::MatrixXd & V, const Eigen::MatrixXi & F,
+            const std::vector<char> & is_feature, const Eigen::VectorXd & high,
+            const Eigen::VectorXd & low);
+
+    // Writes the live vertices and faces back, keeping their relative order
+    // (new elements come after the ones they were created from).
+    void export_to(Eigen::MatrixXd & V, Eigen::MatrixXi & F,
+            Eigen::VectorXi & feature, Eigen::VectorXd & high,
+            Eigen::VectorXd & low) const;
+    // Same as above, with the features as one flag per exported vertex
+    void export_to(Eigen::MatrixXd & V, Eigen::MatrixXi & F,
+            std::vector<char> & is_feature, Eigen::VectorXd & high,
+            Eigen::VectorXd & low) const;
+    // Same as above, positions and faces only
+    void export_to(Eigen::MatrixXd & V, Eigen::MatrixXi & F) const;
+
+    // Number of vertex, face and halfedge slots, including deleted ones
+    int num_vertices() const { return m_position.size(); }
+    int num_faces() const { return m_corner.size() / 3; }
+    int num_halfedges() const { return m_corner.size(); }
+
+    // Connectivity
+    static int face(int h) { return h / 3; }
+    static int next(int h) { return h - h % 3 + (h + 1) % 3; }
+    static int prev(int h) { return h - h % 3 + (h + 2) % 3; }
+    int twin(int h) const { return m_twin[h]; }
+    int from(int h) const { return m_corner[h]; }
+    int to(int h) const { return m_corner[next(h)]; }
+    // Vertex opposite to halfedge h in its face
+    int opposite(int h) const { return m_corner[prev(h)]; }
+    bool is_boundary_edge(int h) const { return m_twin[h] < 0; }
+    bool is_face_deleted(int f) const { return m_corner[3 * f] < 0; }
+    bool is_vertex_deleted(int v) const { return m_is_deleted[v]; }
+    bool is_boundary_vertex(int v) const;
+
+    // Calls fn(h) for every outgoing halfedge h of vertex v, in order around
+    // v; on the boundary the walk starts right after the incoming boundary
+    // halfedge and ends with the outgoing one.
+    template <typename Fn>
+    void for_each_outgoing(int v, Fn fn) const
+    {
+        const int start = m_out[v];
+        if (start < 0) {
+            return;
+        }
+        int h = start;
+        while (m_twin[prev(h)] >= 0 && m_twin[prev(h)] != start) {
+            h = m_twin[prev(h)];
+        }
+        const int first = h;
+        do {
+            fn(h);
+            if (m_twin[h] < 0) {
+                break;
+            }
+            h = next(m_twin[h]);
+        } while (h != first);
+    }
+
+    // Number of faces incident to v
+    int valence(int v) const;
+
+    // Per-vertex attributes
+    Eigen::Vector3d & position(int v) { return m_position[v]; }
+    const Eigen::Vector3d & position(int v) const { return m_position[v]; }
+    double high(int v) const { return m_high[v]; }
+    double low(int v) const { return m_low[v]; }
+    bool is_feature(int v) const { return m_is_feature[v]; }
+
+    double length(int h) const { return (m_position[to(h)] - m_position[from(h)]).norm(); }
+
+    // Splits the interior edge of halfedge h = (a,b) at its midpoint m. With
+    // c and d the vertices opposite to h and twin(h), the faces (a,b,c) and
+    // (b,a,d) become (a,m,c) and (b,m,d), and (m,b,c) and (m,a,d) are added.
+    // Returns m; afterwards h runs from a to m and twin(h) from m to a.
+    int split_edge(int h);
+
+    // Same as above, but m and the two new faces f and f+1 are slots taken
+    // beforehand with add_vertices and add_faces. Splits of edges whose two
+    // faces share no vertex with each other write disjoint data, so they can
+    // run concurrently.
+    void split_edge(int h, int m, int f);
+
+    // Append count unconnected vertex or face slots; return the first index
+    int add_vertices(int count);
+    int add_faces(int count);
+
+    // Whether collapsing the interior edge of h keeps the mesh a manifold:
+    // neither endpoint is on the boundary, the endpoints share no neighbours
+    // other than the two opposite vertices (link condition) and no vertex is
+    // left with fewer than three faces.
+    bool is_collapse_ok(int h) const;
+
+    // Collapses the edge of h into from(h), which is moved to p; to(h) and
+    // the two faces of the edge are deleted.
+    void collapse_edge(int h, const Eigen::Vector3d & p);
+
+    // Replaces the edge (a,b) of h by the edge (c,d) between the opposite
+    // vertices. The two faces keep their indices; returns the halfedge
+    // running from d to c.
+    int flip_edge(int h);
+
+private:
+    void set_twin(int h, int t);
+
+    std::vector<Eigen::Vector3d> m_position;
+    std::vector<double> m_high, m_low;
+    std::vector<char> m_is_feature;
+    std::vector<char> m_is_deleted;
+    // One outgoing halfedge per vertex, -1 for isolated and deleted vertices
+    std::vector<int> m_out;
+
+    // Vertex at the start of every halfedge, -1 for deleted faces
+    std::vector<int> m_corner;
+    std::vector<int> m_twin;
+};
+
+
+#endif
@@ -1,9 +1,11 @@
+#include "remesh_botsch.h"
 #include "equalize_valences.h"
 #include "collapse_edges.h"
 #include "tangential_relaxation.h"
 #include <igl/is_edge_manifold.h>
 #include <igl/writeOBJ.h>
 #include "split_edges_until_bound.h"
+#include "halfedge_mesh.h"
 #include <igl/unique_edge_map.h>
 #include <igl/edge_flaps.h>
 #include <igl/circulation.h>
@@ -11,29 +13,73 @@
 #include <igl/avg_edge_length.h>
 #include <iostream>
 
-void remesh_botsch(Eigen::MatrixXd & V,Eigen::MatrixXi & F, Eigen::VectorXd & target,int iters, Eigen::VectorXi & feature, bool project){
+void remesh_botsch(Eigen::MatrixXd & V,Eigen::MatrixXi & F, Eigen::VectorXd & target,int iters, std::vector<char> & is_feature, bool project, int num_threads, std::vector<RemeshIterationStats> & stats){
     Eigen::MatrixXd V0;
     Eigen::MatrixXi F0;
 
-    Eigen::VectorXd high,low,lambda;
+    Eigen::VectorXd high,low;
     high = 1.4*target;
     low = 0.7*target;
 
 	F0 = F;
 	V0 = V;
+	// The reference surface stays the input when projecting, so its tree is
+	// built once and shared by all iterations
+	igl::AABB<Eigen::MatrixXd,3> tree;
+	if(project){
+		tree.init(V0,F0);
+	}
+    // All four steps edit the same mesh, whose deleted elements are only
+    // compacted away once at the end
+    HalfedgeMesh mesh(V,F,is_feature,high,low);
+    const double stationary_displacement = target.size() > 0 ? 1e-2*target.minCoeff() : 0;
+    stats.clear();
     // Iterate the four steps
     for (int i = 0; i<iters; i++) {
-    	split_edges_until_bound(V,F,feature,high,low); // Split
-    	collapse_edges(V,F,feature,high,low); // Collapse
-    	equalize_valences(V,F,feature); // Flip
-    	int n = V.rows();
-    	lambda = Eigen::VectorXd::Constant(n,1.0);
+	RemeshIterationStats iteration;
+    	iteration.splits = split_edges_until_bound(mesh,num_threads); // Split
+    	iteration.collapses = collapse_edges(mesh); // Collapse
+    	iteration.flips = equalize_valences(mesh,num_threads); // Flip
 	if(!project){
-		V0 = V;
-		F0 = F;
+		mesh.export_to(V0,F0);
+		tree.deinit();
+		tree.init(V0,F0);
+	}
+	iteration.max_displacement = tangential_relaxation(mesh,V0,F0,tree,1.0,num_threads); // Relax
+	stats.push_back(iteration);
+	if(iteration.splits == 0 && iteration.collapses == 0 && iteration.flips == 0 &&
+			iteration.max_displacement <= stationary_displacement){
+		break;
 	}
-	tangential_relaxation(V,F,feature,V0,F0,lambda); // Relax
     }
+    mesh.export_to(V,F,is_feature,high,low);
+}
+
+void remesh_botsch(Eigen::MatrixXd & V,Eigen::MatrixXi & F, Eigen::VectorXd & target,int iters, Eigen::VectorXi & feature, bool project, int num_threads, std::vector<RemeshIterationStats> & stats){
+	std::vector<char> is_feature(V.rows(),0);
+	for (int s = 0; s < feature.size(); s++) {
+		is_feature[feature(s)] = 1;
+	}
+	remesh_botsch(V,F,target,iters,is_feature,project,num_threads,stats);
+	int num_features = 0;
+	for (char f : is_feature) {
+		num_features += f;
+	}
+	feature.resize(num_features);
+	for (int i = 0, s = 0; i < (int)is_feature.size(); i++) {
+		if (is_feature[i]) {
+			feature(s++) = i;
+		}
+	}
+}
+
+void remesh_botsch(Eigen::MatrixXd & V,Eigen::MatrixXi & F, Eigen::VectorXd & target,int iters, Eigen::VectorXi & feature, bool project, int num_threads){
+	std::vector<RemeshIterationStats> stats;
+	remesh_botsch(V,F,target,iters,feature,project,num_threads,stats);
+}
+
+void remesh_botsch(Eigen::MatrixXd & V,Eigen::MatrixXi & F, Eigen::VectorXd & target,int iters, Eigen::VectorXi & feature, bool project){
+remesh_botsch(V,F,target,iters,feature,project,1);
 }
 
 void remesh_botsch(Eigen::MatrixXd & V,Eigen::MatrixXi & F, Eigen::VectorXd & target,int iters, Eigen::VectorXi & feature){
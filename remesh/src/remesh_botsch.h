@@ -4,6 +4,32 @@
 
 
 #include <Eigen/Core>
+#include <vector>
+
+// What one iteration of remesh_botsch did
+struct RemeshIterationStats{
+    int splits = 0;
+    int collapses = 0;
+    int flips = 0;
+    // Largest distance a vertex moved in the relaxation
+    double max_displacement = 0;
+};
+
+// Runs at most iters iterations and stops early once one neither changes the
+// connectivity nor moves any vertex by more than a hundredth of the smallest
+// target; stats receives one entry per iteration that ran.
+//
+// With num_threads > 1 the splits and flips are applied in parallel rounds of
+// edges with vertex-disjoint neighbourhoods. The result then differs from the
+// serial one, but not between thread counts.
+void remesh_botsch(Eigen::MatrixXd & V,Eigen::MatrixXi & F,Eigen::VectorXd & target,int iters, Eigen::VectorXi & feature, bool project, int num_threads, std::vector<RemeshIterationStats> & stats);
+
+// Same as above, with the features given as one flag per vertex
+// (is_feature[v] != 0 for a feature vertex) instead of a list of indices.
+// On return is_feature holds one flag per output vertex.
+void remesh_botsch(Eigen::MatrixXd & V,Eigen::MatrixXi & F,Eigen::VectorXd & target,int iters, std::vector<char> & is_feature, bool project, int num_threads, std::vector<RemeshIterationStats> & stats);
+
+void remesh_botsch(Eigen::MatrixXd & V,Eigen::MatrixXi & F,Eigen::VectorXd & target,int iters, Eigen::VectorXi & feature, bool project, int num_threads);
 
 void remesh_botsch(Eigen::MatrixXd & V,Eigen::MatrixXi & F,Eigen::VectorXd & target,int iters, Eigen::VectorXi & feature, bool project);
 
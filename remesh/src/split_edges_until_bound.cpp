@@ -25,76 +25,137 @@
 #include <igl/decimate.h>
 #include <igl/shortest_edge_and_midpoint.h>
 #include <igl/infinite_cost_stopping_condition.h>
-#include "split_edges.h"
+#include "split_edges_until_bound.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
 using namespace std;
 
 void split_edges_until_bound(Eigen::MatrixXd & V,Eigen::MatrixXi & F, Eigen::VectorXi & feature, Eigen::VectorXd & high, Eigen::VectorXd & low){
+    HalfedgeMesh mesh(V,F,feature,high,low);
+    split_edges_until_bound(mesh);
+    mesh.export_to(V,F,feature,high,low);
+}
 
-    using namespace Eigen;
-    int m = F.rows();
-    int n = V.rows();
-    int num_feat = feature.size();
-    std::vector<std::vector<int>> A;
-    std::vector<bool> is_feature_vertex;
-    is_feature_vertex.resize(n);
-    Eigen::VectorXi is_feature_vertex_vec;
-    is_feature_vertex_vec.setZero(n);
-    igl::adjacency_list(F,A);
-    Eigen::MatrixXi E,uE;
-    Eigen::VectorXi EMAP;
-    std::vector<std::vector<int>> uE2E;
-    igl::unique_edge_map(F,E,uE,EMAP,uE2E);
-    int k = uE.rows();
-    //std::cout << "Start split_edges_until_bound" << std::endl;
-
-
-    for (int s = 0; s < num_feat; s++) {
-        is_feature_vertex[feature(s)] = true;
-       // is_feature_vertex_vec(feature(s)) = 1;
+int split_edges_until_bound(HalfedgeMesh & mesh, int num_threads){
+    // Interior edges between non-feature vertices that are above the bound
+    const auto is_too_long = [&](int h){
+        if (mesh.is_face_deleted(HalfedgeMesh::face(h)) || mesh.is_boundary_edge(h)) {
+            return false;
+        }
+        const int a = mesh.from(h);
+        const int b = mesh.to(h);
+        if (mesh.is_feature(a) || mesh.is_feature(b)) {
+            return false;
+        }
+        return mesh.length(h) > (mesh.high(a)+mesh.high(b))/2;
+    };
+
+    // Every split only creates or shortens edges around the new vertex, so
+    // instead of rescanning the mesh after each pass the four edges around
+    // it are queued with the pass they belong to. Splits halve edges, so the
+    // passes are capped at twice the halvings the longest edge needs (the
+    // edges to the opposite vertices are shortened less). The cap keeps
+    // triangles on long unsplittable boundary or feature edges from being
+    // refined forever.
+    std::vector<std::pair<int,int>> worklist;
+    double max_ratio = 1.0;
+    for (int h = 0; h < mesh.num_halfedges(); h++) {
+        if (h < mesh.twin(h) && is_too_long(h)) {
+            worklist.push_back(std::make_pair(h,0));
+            const double bound = (mesh.high(mesh.from(h))+mesh.high(mesh.to(h)))/2;
+            max_ratio = std::max(max_ratio,mesh.length(h)/bound);
+        }
     }
-
-    bool keep_splitting = true;
-    std::vector<int> edges_to_split;
-
-    while (keep_splitting) {
-        //std::cout << "A" << std::endl;
-        edges_to_split.resize(0);
-
-        for (int i = 0; i < uE.rows(); i++) {
-            //std::cout << "B" << std::endl;
-            if (!is_feature_vertex[uE(i,0)] && !is_feature_vertex[uE(i,1)] && uE2E[i].size()==2) {
-            //if (is_feature_vertex_vec(uE(i,0))==0 && is_feature_vertex_vec(uE(i,1))==0 && uE2E[i].size()==2) {
-                if ( (V.row(uE(i,0))-V.row(uE(i,1))).norm()>((high(uE(i,0))+high(uE(i,1)))/2)  ){
-                    edges_to_split.push_back(i);
-                    //std::cout << "C" << std::endl;
-                }
+    const int max_passes = 2*(std::ceil(std::log2(max_ratio))+1);
+
+    // Queues the edges a split of h (with twin t before the split) changed
+    const auto queue_around = [&](int h, int t, int pass, std::vector<std::pair<int,int>> & queue){
+        // The edges (b,c) and (a,d) moved to the new faces, so entries queued
+        // for their old halfedges now point at the edges to c and d instead
+        const int moved[2] = {HalfedgeMesh::next(mesh.twin(t)), HalfedgeMesh::next(mesh.twin(h))};
+        for (int c : moved) {
+            if (is_too_long(c)) {
+                queue.push_back(std::make_pair(c,pass));
             }
         }
+        if (pass+1 >= max_passes) {
+            return;
+        }
+        // The two halves of the split edge and the edges to c and d
+        const int created[4] = {h, mesh.twin(t), HalfedgeMesh::next(h), HalfedgeMesh::next(t)};
+        for (int c : created) {
+            if (is_too_long(c)) {
+                queue.push_back(std::make_pair(c,pass+1));
+            }
+        }
+    };
+
+    int num_splits = 0;
+    if (num_threads <= 1) {
+        for (size_t head = 0; head < worklist.size(); head++) {
+            const int h = worklist[head].first;
+            if (!is_too_long(h)) {
+                continue;
+            }
+            const int t = mesh.twin(h);
+            mesh.split_edge(h);
+            num_splits++;
+            queue_around(h,t,worklist[head].second,worklist);
+        }
+        return num_splits;
+    }
 
-        //std::cout << "B" << std::endl;
-
-        //std::cout << "D" << std::endl;
-        if(edges_to_split.size()==0){
-            keep_splitting = false;
-        }else{
-            // SPLIT EDGES IN VECTOR edges_to_split
-            //
-
-            //std::cout << "Before call to split_edges" << std::endl;
-            //std::cout << edges_to_split.size() << std::endl;
-            split_edges(V,F,E,uE,EMAP,uE2E,high,low,edges_to_split);
-            //igl::writeOBJ("test.obj",V,F);
-            //igl::unique_edge_map(F,E,uE,EMAP,uE2E);
-            //std::cout << igl::is_edge_manifold(F) << std::endl;
-            //std::cout << "After call to split_edges" << std::endl;
-
+    // In parallel the worklist is consumed in rounds. Each round greedily
+    // takes the edges whose two faces share no vertex with an edge taken
+    // before, in worklist order, and splits them all at once; the others
+    // wait for the next round. The rounds only depend on the worklist, so
+    // the result is the same for any number of threads.
+    std::vector<int> claimed(mesh.num_vertices(),-1);
+    std::vector<std::pair<int,int>> batch, next;
+    for (int round = 0; !worklist.empty(); round++) {
+        batch.clear();
+        next.clear();
+        for (const auto & entry : worklist) {
+            const int h = entry.first;
+            if (!is_too_long(h)) {
+                continue;
+            }
+            const int quad[4] = {mesh.from(h), mesh.to(h), mesh.opposite(h), mesh.opposite(mesh.twin(h))};
+            bool is_free = true;
+            for (int v : quad) {
+                is_free = is_free && claimed[v] != round;
+            }
+            if (!is_free) {
+                next.push_back(entry);
+                continue;
+            }
+            for (int v : quad) {
+                claimed[v] = round;
+            }
+            batch.push_back(entry);
         }
 
+        const int batch_size = batch.size();
+        std::vector<int> twins(batch_size);
+        for (int i = 0; i < batch_size; i++) {
+            twins[i] = mesh.twin(batch[i].first);
+        }
+        const int first_vertex = mesh.add_vertices(batch_size);
+        const int first_face = mesh.add_faces(2*batch_size);
+        claimed.resize(mesh.num_vertices(),-1);
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+        for (int i = 0; i < batch_size; i++) {
+            mesh.split_edge(batch[i].first,first_vertex+i,first_face+2*i);
+        }
+        num_splits += batch_size;
 
-       keep_splitting = false; // THIS IS A PATCH, NOT GOOD
+        for (int i = 0; i < batch_size; i++) {
+            queue_around(batch[i].first,twins[i],batch[i].second,next);
+        }
+        worklist.swap(next);
     }
-
-
+    return num_splits;
 }
 
 
@@ -4,8 +4,18 @@
 
 
 #include <Eigen/Core>
+#include "halfedge_mesh.h"
 
+// Splits interior non-feature edges at their midpoint until none is longer
+// than the average high of its endpoints. New vertices are appended after the
+// existing ones, whose indices are kept.
 void split_edges_until_bound(Eigen::MatrixXd & V,Eigen::MatrixXi & F, Eigen::VectorXi & feature, Eigen::VectorXd & high, Eigen::VectorXd & low);
 
+// Same as above, in place on a mesh that can be reused by the other stages.
+// With more than one thread the splits are applied in rounds of edges with
+// vertex-disjoint neighbourhoods, each round in parallel. Returns the number
+// of splits.
+int split_edges_until_bound(HalfedgeMesh & mesh, int num_threads = 1);
+
 
 #endif
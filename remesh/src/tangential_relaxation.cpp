@@ -23,107 +23,158 @@
 #include <igl/C_STR.h>
 #include <igl/flip_edge.h>
 #include <igl/remove_duplicate_vertices.h>
+#include <algorithm>
+#include <vector>
 using namespace std;
 
-void tangential_relaxation(Eigen::MatrixXd & V,Eigen::MatrixXi & F, Eigen::VectorXi & feature,
-        Eigen::MatrixXd & V0 ,Eigen::MatrixXi & F0, Eigen::VectorXd & lambda){
-    using namespace Eigen;
-        MatrixXd Q,P,N,V_projected,V_fixed;
-        VectorXd dblA,sqrD;
-        VectorXi sqrI;
-        std::vector<std::vector<int>> A;
-        Matrix3d I, NN;
-        I.setIdentity();
-        Eigen::MatrixXd SV;
-        Eigen::MatrixXi SVI,SVJ;
-
-
-
-
-
-
-        V_fixed = V;
-
-        int n = V.rows();
-        int m = F.rows();
-
-        //igl::doublearea(V,F,dblA);
-
-        //std::vector<double> vertex_areas;
-        //vertex_areas.setZero(m);
+#include "tangential_relaxation.h"
 
+void tangential_relaxation(Eigen::MatrixXd & V,Eigen::MatrixXi & F, Eigen::VectorXi & feature,
+        Eigen::MatrixXd & V0 ,Eigen::MatrixXi & F0, Eigen::VectorXd & lambda, int num_threads){
+    igl::AABB<Eigen::MatrixXd,3> tree;
+    tree.init(V0,F0);
+    tangential_relaxation(V,F,feature,V0,F0,tree,lambda,num_threads);
+}
 
-        //for (int j = 0; j < m; j++) {
-        //    vertex_areas[F(j,0)] = vertex_areas[F(j,0)] + (abs(dblA(j))/6);
-        //    vertex_areas[F(j,1)] = vertex_areas[F(j,1)] + (abs(dblA(j))/6);
-        //    vertex_areas[F(j,2)] = vertex_areas[F(j,2)] + (abs(dblA(j))/6);
-        //}
+void tangential_relaxation(Eigen::MatrixXd & V,Eigen::MatrixXi & F, Eigen::VectorXi & feature,
+        const Eigen::MatrixXd & V0 ,const Eigen::MatrixXi & F0, const igl::AABB<Eigen::MatrixXd,3> & tree, Eigen::VectorXd & lambda, int num_threads){
+    const int n = V.rows();
+    const int m = F.rows();
+
+    std::vector<bool> is_feature_vertex(n, false);
+    for (int s = 0; s < feature.size(); s++) {
+        is_feature_vertex[feature(s)] = true;
+    }
+
+    // Vertex-vertex adjacency in compressed rows. Every face adds its two
+    // other corners to each of its vertices, the rows are then sorted and
+    // deduplicated in place; valence[i] is the number of distinct entries
+    // at the front of row i.
+    std::vector<int> offsets(n + 1, 0);
+    for (int f = 0; f < m; f++) {
+        for (int j = 0; j < 3; j++) {
+            offsets[F(f,j) + 1] += 2;
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        offsets[i + 1] += offsets[i];
+    }
+    std::vector<int> neighbors(offsets[n]);
+    std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+    for (int f = 0; f < m; f++) {
+        for (int j = 0; j < 3; j++) {
+            const int a = F(f,j);
+            neighbors[cursor[a]++] = F(f,(j + 1) % 3);
+            neighbors[cursor[a]++] = F(f,(j + 2) % 3);
+        }
+    }
+    std::vector<int> valence(n);
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (int i = 0; i < n; i++) {
+        int * begin = neighbors.data() + offsets[i];
+        int * end = neighbors.data() + offsets[i + 1];
+        std::sort(begin, end);
+        valence[i] = std::unique(begin, end) - begin;
+    }
+
+    Eigen::MatrixXd N;
+    igl::per_vertex_normals(V,F,N);
+
+    // Jacobi update: every vertex reads the positions from before the pass,
+    // so the vertices are independent of each other
+    const Eigen::MatrixXd V_old = V;
+#pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (int i = 0; i < n; i++) {
+        if (is_feature_vertex[i] || valence[i] == 0) {
+            continue;
+        }
 
+        // Barycenter of the one-ring
+        Eigen::RowVector3d q = Eigen::RowVector3d::Zero();
+        for (int k = offsets[i]; k < offsets[i] + valence[i]; k++) {
+            q += V_old.row(neighbors[k]);
+        }
+        q /= valence[i];
+
+        // p = v - lambda (I - n n^T) (v - q)
+        const Eigen::RowVector3d normal = N.row(i);
+        const Eigen::RowVector3d d = V_old.row(i) - q;
+        V.row(i) = V_old.row(i) - lambda(i) * (d - normal.dot(d) * normal);
+    }
+
+    // Feature vertices did not move, only the relaxed ones are projected back
+#pragma omp parallel for schedule(dynamic, 256) num_threads(num_threads)
+    for (int i = 0; i < n; i++) {
+        if (is_feature_vertex[i] || valence[i] == 0) {
+            continue;
+        }
+        Eigen::RowVector3d p = V.row(i);
+        Eigen::RowVector3d c;
+        int closest_face;
+        tree.squared_distance(V0,F0,p,closest_face,c);
+        V.row(i) = c;
+    }
+}
 
-        Eigen::MatrixXd N_before,N_after;
-        igl::adjacency_list(F,A);
 
+double tangential_relaxation(HalfedgeMesh & mesh,
+        const Eigen::MatrixXd & V0 ,const Eigen::MatrixXi & F0, const igl::AABB<Eigen::MatrixXd,3> & tree, double lambda, int num_threads){
+    const int n = mesh.num_vertices();
 
-        int num_feat = feature.size();
-        std::vector<bool> is_feature_vertex;
-        is_feature_vertex.resize(n);
+    // Only vertices that are relaxed are written, and each of them only
+    // reads the positions from before the pass
+    std::vector<Eigen::Vector3d> old_position(n);
+    for (int i = 0; i < n; i++) {
+        old_position[i] = mesh.position(i);
+    }
 
-        for (int s = 0; s < num_feat; s++) {
-            is_feature_vertex[feature(s)] = true;
+    double max_displacement = 0;
+#pragma omp parallel for schedule(dynamic, 256) reduction(max:max_displacement) num_threads(num_threads)
+    for (int i = 0; i < n; i++) {
+        if (mesh.is_vertex_deleted(i) || mesh.is_feature(i)) {
+            continue;
         }
 
-        Q.resize(n,3);
-        P.resize(n,3);
-        //           Eigen::MatrixXd N;
-        igl::per_vertex_normals(V,F,N);
-
-        for(int i = 0; i < n; i++){
-            bool is_feature = is_feature_vertex[i];
-            if (!is_feature) {
-
-            Eigen::RowVector3d q,p;
-            q.setZero();
-            p.setZero();
-            double denominator = 0.0;
-            for(int j = 0; j < A[i].size(); j++){
-                q = q + (V.row(A[i][j])/A[i].size());
-                // q = q + (V.row(A[i][j])*vertex_areas[A[i][j]]);
-                // std::cout << q << std::endl;
-                // denominator = denominator + vertex_areas[A[i][j]];
-                } // q is )( barycenter?
-            // q = q/denominator;
-            // N.row(i) = N.row(i)/N.row(i).norm();
-            NN = lambda(i)*(Eigen::MatrixXd::Identity(3,3) - N.row(i).transpose()*(N.row(i)));
-             p = (V.row(i).transpose()-(NN*(V.row(i).transpose() - q.transpose()))).transpose();
-            // p = q;
-             // std::cout << N.row(i) << std::endl;
-
-            V.row(i) = p;
-
-            // igl::per_face_normals(V_projected,F,Eigen::Vector3d(0,0,0),N_after);
-    //            for (int j = 0; j < m ; j++) {
-    //                if (N_before.row(j).dot(N_after.row(j)) < 0) {
-    //                    // std::cout << "Avoided face flipping, I think." << std::endl;
-    //                    V.row(i) = V_fixed.row(i);
-    //                }
-    //            }
-
+        // Barycenter of the one-ring and area weighted normal, as
+        // igl::per_vertex_normals computes it
+        Eigen::Vector3d q = Eigen::Vector3d::Zero();
+        Eigen::Vector3d normal = Eigen::Vector3d::Zero();
+        int valence = 0;
+        int first = -1;
+        mesh.for_each_outgoing(i,[&](int h){
+            const Eigen::Vector3d & b = old_position[mesh.to(h)];
+            const Eigen::Vector3d & c = old_position[mesh.opposite(h)];
+            q += b;
+            normal += (b-old_position[i]).cross(c-old_position[i]);
+            valence++;
+            if (first < 0) {
+                first = h;
             }
+        });
+        if (valence == 0) {
+            continue;
         }
-//        igl::remove_duplicate_vertices(V,0,SV,SVI,SVJ);
-//        std::cout << V.rows()-SV.rows() << std::endl;
-//	igl::writeOBJ("pre-project.obj",V,F);
-//
-	igl::point_mesh_squared_distance(V,V0,F0,sqrD,sqrI,V_projected);
-//
-//
-    V = V_projected;
-//	igl::writeOBJ("post-project.obj",V,F);
-//    igl::remove_duplicate_vertices(V,0,SV,SVI,SVJ);
-//    std::cout << V.rows()-SV.rows() << std::endl;
- //   std::cout << "not projecting!" << std::endl;
+        // On the boundary the walk starts after the incoming boundary edge,
+        // whose other end is no outgoing edge's target
+        if (mesh.is_boundary_edge(HalfedgeMesh::prev(first))) {
+            q += old_position[mesh.opposite(first)];
+            valence++;
+        }
+        q /= valence;
+        normal.normalize();
+
+        // p = v - lambda (I - n n^T) (v - q)
+        const Eigen::Vector3d d = old_position[i] - q;
+        Eigen::RowVector3d p = (old_position[i] - lambda * (d - normal.dot(d) * normal)).transpose();
+
+        Eigen::RowVector3d c;
+        int closest_face;
+        tree.squared_distance(V0,F0,p,closest_face,c);
+        mesh.position(i) = c.transpose();
+        max_displacement = std::max(max_displacement,(mesh.position(i)-old_position[i]).norm());
+    }
+    return max_displacement;
 }
 
-
 // g++ -I/usr/local/libigl/external/eigen -I/usr/local/libigl/include -std=c++11 -framework Accelerate main.cpp remesh_botsch.cpp -o main
 
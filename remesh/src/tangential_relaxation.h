@@ -4,9 +4,23 @@
 
 
 #include <Eigen/Core>
+#include <igl/AABB.h>
+#include "halfedge_mesh.h"
 
 void tangential_relaxation(Eigen::MatrixXd & V,Eigen::MatrixXi & F, Eigen::VectorXi & feature,
-Eigen::MatrixXd & V0 ,Eigen::MatrixXi & F0, Eigen::VectorXd & lambda);
+Eigen::MatrixXd & V0 ,Eigen::MatrixXi & F0, Eigen::VectorXd & lambda, int num_threads=1);
+
+// Same as above, but projects onto V0,F0 through a tree already built over
+// them with tree.init(V0,F0), so it can be shared by several calls. Feature
+// vertices are neither relaxed nor projected. The passes run on num_threads
+// threads.
+void tangential_relaxation(Eigen::MatrixXd & V,Eigen::MatrixXi & F, Eigen::VectorXi & feature,
+const Eigen::MatrixXd & V0 ,const Eigen::MatrixXi & F0, const igl::AABB<Eigen::MatrixXd,3> & tree, Eigen::VectorXd & lambda, int num_threads=1);
+
+// Same as above, in place on the working mesh with a uniform lambda. Returns
+// the largest distance a vertex moved.
+double tangential_relaxation(HalfedgeMesh & mesh,
+const Eigen::MatrixXd & V0 ,const Eigen::MatrixXi & F0, const igl::AABB<Eigen::MatrixXd,3> & tree, double lambda, int num_threads=1);
 
 
 #endif
@@ -0,0 +1,496 @@
+#include <Eigen/Core>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "igl/AABB.h"
+#include "igl/avg_edge_length.h"
+#include "igl/read_triangle_mesh.h"
+#include "igl/triangulated_grid.h"
+#include "igl/upsample.h"
+#include "remesh/src/collapse_edges.h"
+#include "remesh/src/equalize_valences.h"
+#include "remesh/src/halfedge_mesh.h"
+#include "remesh/src/remesh_botsch.h"
+#include "remesh/src/split_edges_until_bound.h"
+#include "remesh/src/tangential_relaxation.h"
+
+#include "indicatorFunctions.h"
+#include "mesh.h"
+#include "param.h"
+#include "stageTimer.h"
+#include "vertexSelector.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+struct BenchSettings
+{
+    std::vector<int>    faceCounts         = {1000, 10000, 100000, 1000000};
+    std::vector<double> selectionFractions = {0.01, 0.1, 0.5};
+    std::vector<std::string> meshKinds     = {"grid", "cloth"};
+    std::string         clothFilename      = "../meshes/cloth/cloth.obj";
+    std::string         outputFilename     = "bench_results.json";
+    std::string         stageFilter;
+    int                 repetitions        = 3;
+    int                 remeshIterations   = 3;
+    int                 paramIterations    = 5;
+    int                 maxParamFaces      = 1000000;
+    int                 numThreads         = 1;
+    double              targetEdgeScale    = 0.75;
+};
+
+struct BenchMesh
+{
+    std::string     kind;
+    Eigen::MatrixXd vertices;
+    Eigen::MatrixXi faces;
+};
+
+/**
+ * A wavy square made of roughly the requested number of faces.
+ */
+BenchMesh makeGridMesh(int numFaces)
+{
+    const int n = std::max(2, (int)std::lround(std::sqrt(numFaces / 2.0)) + 1);
+
+    BenchMesh       mesh{"grid", {}, {}};
+    Eigen::MatrixXd planar;
+    igl::triangulated_grid(n, n, planar, mesh.faces);
+
+    mesh.vertices.resize(planar.rows(), 3);
+    mesh.vertices.leftCols(2) = planar.leftCols(2);
+    for (int i = 0; i < planar.rows(); ++i) {
+        mesh.vertices(i, 2) =
+            0.1 * std::sin(10 * planar(i, 0)) * std::cos(10 * planar(i, 1));
+    }
+    return mesh;
+}
+
+/**
+ * The cloth mesh, upsampled until it has at least half the requested number
+ * of faces.
+ */
+BenchMesh makeClothMesh(const std::string& filename, int numFaces)
+{
+    BenchMesh mesh{"cloth", {}, {}};
+    if (!igl::read_triangle_mesh(filename, mesh.vertices, mesh.faces)) {
+        throw std::runtime_error("Could not load mesh from " + filename);
+    }
+    while (2 * mesh.faces.rows() < numFaces) {
+        Eigen::MatrixXd upsampledVertices;
+        Eigen::MatrixXi upsampledFaces;
+        igl::upsample(
+            mesh.vertices, mesh.faces, upsampledVertices, upsampledFaces);
+        mesh.vertices = upsampledVertices;
+        mesh.faces    = upsampledFaces;
+    }
+    return mesh;
+}
+
+/**
+ * Selects the given fraction of the vertices closest to the centroid, which
+ * gives a single compact patch like the quality-based selection does.
+ */
+std::vector<bool> makeSelection(const Eigen::MatrixXd& vertices,
+                                double                 fraction)
+{
+    Eigen::RowVector3d  centroid = vertices.colwise().mean();
+    std::vector<double> distances(vertices.rows());
+    for (int i = 0; i < vertices.rows(); ++i) {
+        distances[i] = (vertices.row(i) - centroid).squaredNorm();
+    }
+
+    std::vector<int> order(vertices.rows());
+    for (int i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    const int numSelected = std::lround(fraction * vertices.rows());
+    std::partial_sort(order.begin(),
+                      order.begin() + numSelected,
+                      order.end(),
+                      [&](int a, int b) { return distances[a] < distances[b]; });
+
+    std::vector<bool> selection(vertices.rows(), false);
+    for (int i = 0; i < numSelected; ++i) {
+        selection[order[i]] = true;
+    }
+    return selection;
+}
+
+class BenchReport
+{
+   public:
+    BenchReport(const BenchSettings& settings) : m_settings(settings)
+    {
+    }
+
+    /**
+     * Times stage() settings.repetitions times; setup() runs untimed before
+     * every repetition.
+     */
+    void run(const BenchMesh&             mesh,
+             double                       selectionFraction,
+             const std::string&           stageName,
+             const std::function<void()>& setup,
+             const std::function<void()>& stage)
+    {
+        if (!m_settings.stageFilter.empty() &&
+            stageName.find(m_settings.stageFilter) == std::string::npos) {
+            return;
+        }
+
+        locremesh::StageTimer timer;
+        for (int r = 0; r < m_settings.repetitions; ++r) {
+            setup();
+            locremesh::StageTimer::Scope scope(&timer, stageName);
+            stage();
+        }
+
+        const locremesh::StageTimer::Stage& timing = timer.getStages().front();
+        std::cout << mesh.kind << " F=" << mesh.faces.rows()
+                  << " sel=" << selectionFraction << " " << stageName << ": "
+                  << timing.getMinMs() << " ms (min of "
+                  << timing.samplesMs.size() << ")" << std::endl;
+
+        std::stringstream ss;
+        ss << "    {\"mesh\": \"" << mesh.kind
+           << "\", \"vertices\": " << mesh.vertices.rows()
+           << ", \"faces\": " << mesh.faces.rows()
+           << ", \"selection_fraction\": " << selectionFraction
+           << ", \"stage\": \"" << stageName
+           << "\", \"min_ms\": " << timing.getMinMs()
+           << ", \"mean_ms\": " << timing.getTotalMs() / timing.samplesMs.size()
+           << ", \"max_ms\": " << timing.getMaxMs() << ", \"samples_ms\": [";
+        for (int i = 0; i < timing.samplesMs.size(); ++i) {
+            ss << (i ? ", " : "") << timing.samplesMs[i];
+        }
+        ss << "]}";
+        m_entries.push_back(ss.str());
+    }
+
+    void write() const
+    {
+        std::ofstream os(m_settings.outputFilename);
+        os << "{\n  \"build\": {";
+#ifdef NDEBUG
+        os << "\"ndebug\": true";
+#else
+        os << "\"ndebug\": false";
+#endif
+#ifdef __VERSION__
+        os << ", \"compiler\": \"" << __VERSION__ << "\"";
+#endif
+#ifdef _OPENMP
+        os << ", \"openmp\": " << _OPENMP;
+#endif
+        os << ", \"threads\": " << m_settings.numThreads
+           << ", \"repetitions\": " << m_settings.repetitions << "},\n"
+           << "  \"results\": [\n";
+        for (int i = 0; i < m_entries.size(); ++i) {
+            os << m_entries[i] << (i + 1 < m_entries.size() ? "," : "")
+               << "\n";
+        }
+        os << "  ]\n}\n";
+    }
+
+   private:
+    const BenchSettings&     m_settings;
+    std::vector<std::string> m_entries;
+};
+
+/**
+ * One split, collapse, flip and relax pass, timed stage by stage on the same
+ * input as remesh_botsch would see it in its first iteration. The stages run
+ * in place on a HalfedgeMesh, as inside remesh_botsch, so building and
+ * exporting it is left out of their times; remesh_botsch includes both.
+ */
+void benchRemeshStages(BenchReport&             report,
+                       const BenchSettings&     settings,
+                       const BenchMesh&         mesh,
+                       double                   selectionFraction,
+                       const Eigen::VectorXi&   feature)
+{
+    const double target =
+        settings.targetEdgeScale *
+        igl::avg_edge_length(mesh.vertices, mesh.faces);
+    const int n = mesh.vertices.rows();
+
+    const HalfedgeMesh input(mesh.vertices,
+                             mesh.faces,
+                             feature,
+                             Eigen::VectorXd::Constant(n, 1.4 * target),
+                             Eigen::VectorXd::Constant(n, 0.7 * target));
+    HalfedgeMesh       working = input;
+
+    report.run(
+        mesh,
+        selectionFraction,
+        "split_edges_until_bound",
+        [&]() { working = input; },
+        [&]() { split_edges_until_bound(working, settings.numThreads); });
+
+    // Every later stage starts from the output of the previous one
+    HalfedgeMesh split = input;
+    split_edges_until_bound(split, settings.numThreads);
+    report.run(
+        mesh,
+        selectionFraction,
+        "collapse_edges",
+        [&]() { working = split; },
+        [&]() { collapse_edges(working); });
+
+    HalfedgeMesh collapsed = split;
+    collapse_edges(collapsed);
+    report.run(
+        mesh,
+        selectionFraction,
+        "equalize_valences",
+        [&]() { working = collapsed; },
+        [&]() { equalize_valences(working, settings.numThreads); });
+
+    HalfedgeMesh flipped = collapsed;
+    equalize_valences(flipped, settings.numThreads);
+    // Projected onto the input, like remesh_botsch does
+    igl::AABB<Eigen::MatrixXd, 3> tree;
+    tree.init(mesh.vertices, mesh.faces);
+    report.run(
+        mesh,
+        selectionFraction,
+        "tangential_relaxation",
+        [&]() { working = flipped; },
+        [&]() {
+            tangential_relaxation(working,
+                                  mesh.vertices,
+                                  mesh.faces,
+                                  tree,
+                                  1.0,
+                                  settings.numThreads);
+        });
+
+    Eigen::MatrixXd V;
+    Eigen::MatrixXi F;
+    Eigen::VectorXi featureCopy;
+    Eigen::VectorXd targets;
+    report.run(
+        mesh,
+        selectionFraction,
+        "remesh_botsch",
+        [&]() {
+            V           = mesh.vertices;
+            F           = mesh.faces;
+            featureCopy = feature;
+            targets     = Eigen::VectorXd::Constant(n, target);
+        },
+        [&]() {
+            remesh_botsch(V,
+                          F,
+                          targets,
+                          settings.remeshIterations,
+                          featureCopy,
+                          true,
+                          settings.numThreads);
+        });
+}
+
+void benchMesh(BenchReport&         report,
+               const BenchSettings& settings,
+               const BenchMesh&     mesh)
+{
+    // Selection-independent stages
+    Eigen::VectorXd quality;
+    report.run(
+        mesh, 0, "indFuncTriangleQuality", []() {}, [&]() {
+            quality = locremesh::indFuncTriangleQuality(mesh.vertices,
+                                                        mesh.faces);
+        });
+    report.run(
+        mesh, 0, "indFuncTriangleQualityBatched", []() {}, [&]() {
+            quality = locremesh::indFuncTriangleQualityBatched(
+                mesh.vertices, mesh.faces, settings.numThreads);
+        });
+
+    if (mesh.faces.rows() <= settings.maxParamFaces) {
+        Eigen::MatrixXd uv;
+        report.run(
+            mesh, 0, "param_cold", [&]() { uv.resize(0, 0); }, [&]() {
+                param<double>(
+                    mesh.vertices, mesh.faces, uv, settings.paramIterations);
+            });
+
+        // Warm solves start from converged UVs and reuse the setup of the
+        // previous call, as under auto-parametrization
+        Parametrizer<double> parametrizer;
+        Eigen::MatrixXd      previousUV;
+        parametrizer.setNumThreads(settings.numThreads);
+        parametrizer.solve(mesh.vertices, mesh.faces, previousUV, 1);
+        report.run(
+            mesh, 0, "param_warm", [&]() { uv = previousUV; }, [&]() {
+                parametrizer.solve(
+                    mesh.vertices, mesh.faces, uv, settings.paramIterations);
+            });
+    }
+
+    // The Mesh is only needed for the selection stages, skip its
+    // parametrization.
+    locremesh::Mesh           selectorMesh(mesh.vertices, mesh.faces, false);
+    locremesh::VertexSelector vertexSelector(selectorMesh);
+    selectorMesh.setNumThreads(settings.numThreads);
+
+    // Without the incremental mode every run is a full, parallel pass
+    vertexSelector.setIncrementalSelection(false);
+    report.run(
+        mesh, 0, "selectVerticesBasedOnQuality", []() {}, [&]() {
+            vertexSelector.selectVerticesBasedOnQuality();
+        });
+
+    for (double fraction : settings.selectionFractions) {
+        const locremesh::SelectionSet selection(
+            makeSelection(mesh.vertices, fraction));
+        auto resetSelection = [&]() {
+            vertexSelector.getSelection() = selection;
+        };
+
+        report.run(mesh,
+                   fraction,
+                   "applyOneRingDilation",
+                   resetSelection,
+                   [&]() { vertexSelector.applyOneRingDilation(); });
+
+        report.run(mesh,
+                   fraction,
+                   "dilate5",
+                   resetSelection,
+                   [&]() { vertexSelector.dilate(5); });
+
+        Eigen::VectorXi feature;
+        report.run(
+            mesh, fraction, "extractFeatureFromSelection", resetSelection, [&]() {
+                feature = vertexSelector.extractFeatureFromSelection();
+            });
+
+        std::vector<char> isFeature;
+        report.run(mesh,
+                   fraction,
+                   "extractFeatureMaskFromSelection",
+                   resetSelection,
+                   [&]() {
+                       isFeature =
+                           vertexSelector.extractFeatureMaskFromSelection();
+                   });
+
+        resetSelection();
+        feature = vertexSelector.extractFeatureFromSelection();
+        benchRemeshStages(report, settings, mesh, fraction, feature);
+    }
+}
+
+template <typename T>
+std::vector<T> parseList(const std::string& list)
+{
+    std::vector<T>    values;
+    std::stringstream ss(list);
+    std::string       item;
+    while (std::getline(ss, item, ',')) {
+        std::stringstream itemStream(item);
+        T                 value;
+        itemStream >> value;
+        values.push_back(value);
+    }
+    return values;
+}
+
+void printUsage()
+{
+    std::cout << R"(Benchmarks the stages of the remeshing pipeline and writes the results to JSON.
+
+./LocRemeshBench [options]
+
+  --sizes 1000,10000,...     target face counts (default 1k to 1M)
+  --fractions 0.01,0.1,...   selection fractions (default 0.01,0.1,0.5)
+  --meshes grid,cloth        generated mesh families (default both)
+  --cloth path               cloth mesh to upsample (default ../meshes/cloth/cloth.obj)
+  --stage name               only run stages whose name contains this
+  --repetitions N            repetitions per stage (default 3)
+  --remesh-iterations N      remesh_botsch iterations (default 3)
+  --param-iterations N       Newton iterations of param (default 5)
+  --max-param-faces N        skip param above this face count (default 1M)
+  --target-scale F           target edge length / mean edge length (default 0.75)
+  --threads N                threads of the parallel kernels (default 1)
+  --out path                 output file (default bench_results.json)
+)";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    BenchSettings settings;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg     = argv[i];
+        auto        nextArg = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << arg << std::endl;
+                std::exit(1);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--sizes") {
+            settings.faceCounts = parseList<int>(nextArg());
+        } else if (arg == "--fractions") {
+            settings.selectionFractions = parseList<double>(nextArg());
+        } else if (arg == "--meshes") {
+            settings.meshKinds = parseList<std::string>(nextArg());
+        } else if (arg == "--cloth") {
+            settings.clothFilename = nextArg();
+        } else if (arg == "--stage") {
+            settings.stageFilter = nextArg();
+        } else if (arg == "--repetitions") {
+            settings.repetitions = std::stoi(nextArg());
+        } else if (arg == "--remesh-iterations") {
+            settings.remeshIterations = std::stoi(nextArg());
+        } else if (arg == "--param-iterations") {
+            settings.paramIterations = std::stoi(nextArg());
+        } else if (arg == "--max-param-faces") {
+            settings.maxParamFaces = std::stoi(nextArg());
+        } else if (arg == "--target-scale") {
+            settings.targetEdgeScale = std::stod(nextArg());
+        } else if (arg == "--threads") {
+            settings.numThreads = std::stoi(nextArg());
+        } else if (arg == "--out") {
+            settings.outputFilename = nextArg();
+        } else {
+            printUsage();
+            return arg == "--help" ? 0 : 1;
+        }
+    }
+
+#ifdef _OPENMP
+    omp_set_num_threads(settings.numThreads);
+#endif
+
+    BenchReport report(settings);
+    for (const std::string& kind : settings.meshKinds) {
+        for (int numFaces : settings.faceCounts) {
+            BenchMesh mesh = kind == "cloth"
+                                 ? makeClothMesh(settings.clothFilename, numFaces)
+                                 : makeGridMesh(numFaces);
+            benchMesh(report, settings, mesh);
+        }
+    }
+    report.write();
+
+    std::cout << "Wrote " << settings.outputFilename << std::endl;
+    return 0;
+}
@@ -3,77 +3,170 @@
 #include "mesh.h"
 #include "utils.h"
 
+#include <algorithm>
+
 namespace locremesh {
 
-void BotschRemesher::remesh(std::string resultingMeshPolyscopeID)
+void BotschRemesher::remesh()
 {
-    auto feature    = m_vertexSelector.extractFeatureFromSelection();
-    auto targetMesh = m_vertexSelector.getTargetMesh();
-
-    if (feature.size() == targetMesh.getVertexCount()) {
+    if (m_vertexSelector.extractActiveFromSelection().empty()) {
         std::cout << "No vertices to remesh" << std::endl;
         return;
     }
 
-    Eigen::VectorXd targetEdgeLengthsVector = Eigen::VectorXd::Constant(
-        targetMesh.getVertexCount(), m_targetEdgeLength);
+    // The sizing field is a pass over the whole mesh, so it is computed once
+    // and shared by the localized remesh and its fallback, which sees the
+    // same mesh
+    Eigen::VectorXd targetEdgeLengthsVector =
+        computeTargetEdgeLengths(m_resultingMesh);
 
-    if (m_keepOriginalMesh) {
-        // Create a copy of the mesh
-        m_resultingMesh = Mesh(targetMesh);
-        m_resultingMesh.setPolyscopeID(resultingMeshPolyscopeID);
-    } else {
-        m_resultingMesh = targetMesh;
+    if (m_localizedRemeshing) {
+        std::cout << "Running localized remesh_botsch..." << std::endl;
+        if (remeshSelectedRegion(targetEdgeLengthsVector)) {
+            std::cout << "Finished remesh_botsch after "
+                      << m_lastIterationStats.size() << " iterations"
+                      << std::endl;
+            return;
+        }
+        std::cout << "Localized remeshing failed, falling back to the whole "
+                     "mesh"
+                  << std::endl;
     }
 
     std::cout << "Running remesh_botsch..." << std::endl;
+    std::vector<char> isFeature =
+        m_vertexSelector.extractFeatureMaskFromSelection();
+    const Eigen::MatrixXd previousVertices = m_resultingMesh.getVertices();
+    const Eigen::MatrixXi previousFaces    = m_resultingMesh.getFaces();
     remesh_botsch(m_resultingMesh.getVertices(),
                   m_resultingMesh.getFaces(),
                   targetEdgeLengthsVector,
                   m_iterations,
-                  feature,
-                  m_shouldProject);
+                  isFeature,
+                  m_shouldProject,
+                  m_resultingMesh.getNumThreads(),
+                  m_lastIterationStats);
+    m_resultingMesh.transferRestVertices(previousVertices, previousFaces);
+    m_resultingMesh.notifyTopologyChanged();
     m_resultingMesh.identifyBoundaryVertices();
     m_resultingMesh.calculateMeshQuality();
-    std::cout << "Finished remesh_botsch" << std::endl;
+    // Every face is new
+    StitchMap map;
+    map.faceSource.assign(m_resultingMesh.getFaceCount(), -1);
+    m_vertexSelector.notifyRemeshed(map);
+    std::cout << "Finished remesh_botsch after " << m_lastIterationStats.size()
+              << " iterations" << std::endl;
 }
 
-void BotschRemesher::polyscopeUISection()
+/**
+ * Remeshes only the faces around the selected vertices. Every connected
+ * component of the selection is cut out together with a frozen ring of
+ * vertices and remeshed on its own thread, then all of them are stitched back
+ * at once, so the cost scales with the size of the selection instead of the
+ * size of the mesh.
+ *
+ * Patches whose frozen ring did not survive the remesh are left out and their
+ * region keeps its old faces.
+ *
+ * @param parentTargetEdgeLengths The target edge length of every vertex of
+ * the resulting mesh. The patch vertices are all parent vertices before the
+ * remesh, so they take their targets from it.
+ * @return false if no patch could be stitched back, in which case the
+ * resulting mesh is left untouched.
+ */
+bool BotschRemesher::remeshSelectedRegion(
+    const Eigen::VectorXd& parentTargetEdgeLengths)
 {
-    auto targetMesh = m_vertexSelector.getTargetMesh();
+    std::vector<Submesh> patches =
+        extractSubmeshes(m_resultingMesh.getVertices(),
+                         m_resultingMesh.getFaces(),
+                         m_resultingMesh.getConnectivity(),
+                         m_vertexSelector.extractActiveFromSelection());
+    const int numPatches = patches.size();
 
-    ImGui::Text("Remeshing");
-    ImGui::SliderFloat("Target Edge Length", &m_targetEdgeLength, 0.01f, 1.f);
-    ImGui::SliderInt("Iterations", &m_iterations, 1, 100);
-    ImGui::Checkbox("Project resulting mesh onto the original",
-                    &m_shouldProject);
-    // ImGui::Checkbox("Keep original mesh", &m_keepOriginalMesh);
+    // Patches are spread over the threads; a lone patch gets them all for the
+    // parallel stages of the remesher instead. The outer loop must then stay
+    // serial, nested parallel regions would run on a single thread.
+    const int numThreads      = m_resultingMesh.getNumThreads();
+    const int numPatchThreads = numPatches > 1 ? 1 : numThreads;
+    std::vector<std::vector<RemeshIterationStats>> patchStats(numPatches);
+    std::vector<char> isStitchable(numPatches, 0);
+#pragma omp parallel for schedule(dynamic) \
+    if (numPatches > 1 && numThreads > 1) num_threads(numThreads)
+    for (int p = 0; p < numPatches; ++p) {
+        Submesh&        patch = patches[p];
+        Eigen::VectorXd targetEdgeLengthsVector(patch.vertices.rows());
+        for (int i = 0; i < patch.vertices.rows(); ++i) {
+            targetEdgeLengthsVector[i] =
+                parentTargetEdgeLengths[patch.parentVertexIdxs[i]];
+        }
 
-    // if (ImGui::Button("Remesh")) {
-    //     try {
-    //         remesh();
-    //     } catch (const std::exception& e) {
-    //         std::cerr << "Error during remeshing: " << e.what() << std::endl;
-    //         return;
-    //     }
+        remesh_botsch(patch.vertices,
+                      patch.faces,
+                      targetEdgeLengthsVector,
+                      m_iterations,
+                      patch.feature,
+                      m_shouldProject,
+                      numPatchThreads,
+                      patchStats[p]);
 
-    //     // Update polyscope mesh
-    //     auto sm = m_resultingMesh.polyscopeRegisterSurfaceMesh();
+        // The frozen ring must come out of the remesher untouched and still
+        // at the front, otherwise the seam cannot be matched with the parent
+        // mesh.
+        isStitchable[p] = patch.feature.size() == patch.numFrozenVertices;
+        for (int i = 0; isStitchable[p] && i < patch.numFrozenVertices; ++i) {
+            isStitchable[p] = patch.feature[i] == i;
+        }
+    }
 
-    //     if (m_keepOriginalMesh) {
-    //         sm->setPosition({0, 0, 1});
-    //     } else {
-    //         m_vertexSelector.updateTargetMesh(m_resultingMesh);
-    //     }
-    // }
+    // Per iteration totals over the patches, as if they were one mesh
+    m_lastIterationStats.clear();
+    for (const auto& stats : patchStats) {
+        if (stats.size() > m_lastIterationStats.size()) {
+            m_lastIterationStats.resize(stats.size());
+        }
+        for (int i = 0; i < stats.size(); ++i) {
+            m_lastIterationStats[i].splits += stats[i].splits;
+            m_lastIterationStats[i].collapses += stats[i].collapses;
+            m_lastIterationStats[i].flips += stats[i].flips;
+            m_lastIterationStats[i].max_displacement =
+                std::max(m_lastIterationStats[i].max_displacement,
+                         stats[i].max_displacement);
+        }
+    }
 
-    // if (ImGui::Button("Reset")) {
-    //     if (m_resultingMesh.getPolyscopeID() !=
-    //         m_vertexSelector.getTargetMesh().getPolyscopeID()) {
-    //         if (polyscope::hasSurfaceMesh(m_resultingMesh.getPolyscopeID())) {
-    //             polyscope::removeSurfaceMesh(m_resultingMesh.getPolyscopeID());
-    //         }
-    //     }
-    // }
+    std::vector<Submesh> stitchablePatches;
+    for (int p = 0; p < numPatches; ++p) {
+        if (isStitchable[p]) {
+            stitchablePatches.push_back(std::move(patches[p]));
+        }
+    }
+    if (stitchablePatches.empty()) {
+        return false;
+    }
+    if (stitchablePatches.size() < numPatches) {
+        std::cout << numPatches - stitchablePatches.size() << " of "
+                  << numPatches << " patches could not be stitched back"
+                  << std::endl;
+    }
+
+    m_vertexSelector.notifyRemeshed(
+        m_resultingMesh.replaceRegions(stitchablePatches));
+    return true;
+}
+
+/**
+ * The per-vertex target edge lengths handed to remesh_botsch, either constant
+ * or from the sizing field. New vertices interpolate the targets of the edge
+ * they split.
+ */
+Eigen::VectorXd BotschRemesher::computeTargetEdgeLengths(Mesh& mesh)
+{
+    if (m_useSizingField) {
+        return m_sizingField.compute(mesh, m_targetEdgeLength);
+    }
+    return Eigen::VectorXd::Constant(mesh.getVertexCount(),
+                                     m_targetEdgeLength);
 }
+
 }  // namespace locremesh
\ No newline at end of file
@@ -4,11 +4,11 @@
 #include <set>
 #include <vector>
 
-#include "polyscope/point_cloud.h"
-#include "polyscope/surface_mesh.h"
 #include "remesh/src/remesh_botsch.h"
 
 #include "mesh.h"
+#include "sizingField.h"
+#include "submesh.h"
 #include "vertexSelector.h"
 
 namespace locremesh {
@@ -21,23 +21,38 @@ class BotschRemesher
                    int             initialIterations,
                    bool            initialShouldProject)
         : m_vertexSelector(vertexSelector),
+          m_resultingMesh(vertexSelector.getTargetMesh()),
           m_targetEdgeLength(initialTargetEdgeLength),
           m_iterations(initialIterations),
-          m_shouldProject(initialShouldProject),
-          m_resultingMesh(vertexSelector.getTargetMesh())
+          m_shouldProject(initialShouldProject)
     {
     }
 
-    void remesh(std::string resultingMeshPolyscopeID = "botschRemeshed");
+    // Remeshes the target mesh of the selector in place
+    void remesh();
+    // Defined in ui/, which only the viewer is built with
     void polyscopeUISection();
 
+   private:
+    bool            remeshSelectedRegion(
+                   const Eigen::VectorXd& parentTargetEdgeLengths);
+    Eigen::VectorXd computeTargetEdgeLengths(Mesh& mesh);
+
    public:
     VertexSelector& m_vertexSelector;
     Mesh&           m_resultingMesh;
-    bool            m_keepOriginalMesh = false;
+    bool            m_localizedRemeshing = true;
     float           m_targetEdgeLength;
     int             m_iterations;
     bool            m_shouldProject;
+    // Vary the target edge length over the mesh instead of using
+    // m_targetEdgeLength everywhere
+    bool        m_useSizingField = false;
+    SizingField m_sizingField;
+
+    // What every iteration of the last remesh_botsch call did; it stops
+    // early once the mesh no longer changes
+    std::vector<RemeshIterationStats> m_lastIterationStats;
 };
 
 };  // namespace locremesh
\ No newline at end of file
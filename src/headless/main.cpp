@@ -0,0 +1,235 @@
+#include <Eigen/Core>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+#include "igl/writeOBJ.h"
+
+#include "botschRemesher.h"
+#include "mesh.h"
+#include "simulation.h"
+#include "stageTimer.h"
+#include "vertexSelector.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+void printUsage()
+{
+    std::cout << R"(Runs the deform, select, remesh and parametrize loop without a window.
+
+./LocRemeshHeadless mesh.ext [options]
+
+  --steps N                  number of fixed timesteps (default 100)
+  --updates-per-second F     timestep is 1/F seconds (default 50)
+  --frequency F              spatial frequency of the sinewave (default 15)
+  --amplitude F              amplitude of the sinewave (default 0.1)
+  --quality-threshold F      faces at or below are selected (default 0.4)
+  --quality-exit-margin F    selected faces stay up to threshold + F (0.05)
+  --remesh-cooldown N        steps new faces cannot be selected (default 3)
+  --min-region-size N        skip smaller selected regions (default 1)
+  --dilation N               one-ring dilation passes (default 5)
+  --dilation-radius F        limit the dilation to this distance (default off)
+  --euclidean-dilation       measure the radius in space, not along edges
+  --edge-length F            remesh target edge length (default 0.06)
+  --remesh-iterations N      remesh_botsch iterations (default 10)
+  --no-project               do not project onto the original surface
+  --adaptive                 vary the target edge length with a sizing field
+  --global-remesh            remesh the whole mesh instead of the selection
+  --no-remesh                disable automatic remeshing
+  --auto-param               reparametrize every step when not remeshing
+  --param-iterations N       max Newton iterations of the parametrization
+  --global-param             reparametrize the whole mesh after remeshing
+  --param-rings N            free rings around remeshed patches (default 1)
+  --threads N                threads used by the parallel kernels (default 1)
+  --out-mesh path            final mesh with UVs (default headless_output.obj)
+  --out-timings path         per-stage timings (default headless_timings.json)
+)";
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc == 1) {
+        printUsage();
+        return 0;
+    }
+
+    // Configurations //////////////////////////////////////////////////////////
+    std::string inputMeshFilename  = argv[1];
+    std::string outputMeshFilename = "headless_output.obj";
+    std::string timingsFilename    = "headless_timings.json";
+
+    int   numSteps                     = 100;
+    float updatesPerSecond             = 50.f;
+    float spatialFrequency             = 15.f;
+    float amplitude                    = 0.1f;
+    float qualityThreshold             = 0.4f;
+    float qualityExitMargin            = 0.05f;
+    int   remeshCooldown               = 3;
+    int   minRegionSize                = 1;
+    int   numOneRingDilationIterations = 5;
+    float dilationRadius               = 0.f;
+    bool  euclideanDilation            = false;
+    float targetEdgeLength             = 0.06f;
+    int   numRemeshIterations          = 10;
+    bool  shouldProject                = true;
+    bool  useSizingField               = false;
+    bool  localizedRemeshing           = true;
+    bool  autoRemeshing                = true;
+    bool  autoParametrization          = false;
+    int   numParamIterations           = 10;
+    bool  localParametrization         = true;
+    int   numLocalParamRings           = 1;
+    int   numThreads                   = 1;
+
+    for (int i = 2; i < argc; ++i) {
+        std::string arg     = argv[i];
+        auto        nextArg = [&]() -> const char* {
+            if (i + 1 >= argc) {
+                std::cerr << "Missing value for " << arg << std::endl;
+                std::exit(1);
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--steps") {
+            numSteps = std::atoi(nextArg());
+        } else if (arg == "--updates-per-second") {
+            updatesPerSecond = std::atof(nextArg());
+        } else if (arg == "--frequency") {
+            spatialFrequency = std::atof(nextArg());
+        } else if (arg == "--amplitude") {
+            amplitude = std::atof(nextArg());
+        } else if (arg == "--quality-threshold") {
+            qualityThreshold = std::atof(nextArg());
+        } else if (arg == "--quality-exit-margin") {
+            qualityExitMargin = std::atof(nextArg());
+        } else if (arg == "--remesh-cooldown") {
+            remeshCooldown = std::atoi(nextArg());
+        } else if (arg == "--min-region-size") {
+            minRegionSize = std::atoi(nextArg());
+        } else if (arg == "--dilation") {
+            numOneRingDilationIterations = std::atoi(nextArg());
+        } else if (arg == "--dilation-radius") {
+            dilationRadius = std::atof(nextArg());
+        } else if (arg == "--euclidean-dilation") {
+            euclideanDilation = true;
+        } else if (arg == "--edge-length") {
+            targetEdgeLength = std::atof(nextArg());
+        } else if (arg == "--remesh-iterations") {
+            numRemeshIterations = std::atoi(nextArg());
+        } else if (arg == "--no-project") {
+            shouldProject = false;
+        } else if (arg == "--adaptive") {
+            useSizingField = true;
+        } else if (arg == "--global-remesh") {
+            localizedRemeshing = false;
+        } else if (arg == "--no-remesh") {
+            autoRemeshing = false;
+        } else if (arg == "--auto-param") {
+            autoParametrization = true;
+        } else if (arg == "--param-iterations") {
+            numParamIterations = std::atoi(nextArg());
+        } else if (arg == "--global-param") {
+            localParametrization = false;
+        } else if (arg == "--param-rings") {
+            numLocalParamRings = std::atoi(nextArg());
+        } else if (arg == "--threads") {
+            numThreads = std::atoi(nextArg());
+        } else if (arg == "--out-mesh") {
+            outputMeshFilename = nextArg();
+        } else if (arg == "--out-timings") {
+            timingsFilename = nextArg();
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            printUsage();
+            return 1;
+        }
+    }
+
+#ifdef _OPENMP
+    // Caps the OpenMP regions that take no explicit thread count, e.g. in
+    // libigl
+    omp_set_num_threads(numThreads);
+#endif
+
+    locremesh::StageTimer stageTimer;
+
+    std::unique_ptr<locremesh::Mesh> inputMesh;
+    {
+        locremesh::StageTimer::Scope scope(&stageTimer, "load");
+        inputMesh = std::make_unique<locremesh::Mesh>(
+            inputMeshFilename, "", "inputMesh");
+    }
+    inputMesh->setParamatrizationIterations(numParamIterations);
+    inputMesh->setNumThreads(numThreads);
+
+    locremesh::VertexSelector vertexSelector(*inputMesh, qualityThreshold);
+    vertexSelector.setQualityExitMargin(qualityExitMargin);
+    vertexSelector.setRemeshCooldown(remeshCooldown);
+    vertexSelector.setMinRegionSize(minRegionSize);
+    locremesh::BotschRemesher botschRemesher(
+        vertexSelector, targetEdgeLength, numRemeshIterations, shouldProject);
+    botschRemesher.m_localizedRemeshing = localizedRemeshing;
+    botschRemesher.m_useSizingField     = useSizingField;
+
+    locremesh::Simulation simulation(*inputMesh, vertexSelector, botschRemesher);
+    simulation.m_spatialFrequency             = spatialFrequency;
+    simulation.m_amplitude                    = amplitude;
+    simulation.m_numOneRingDilationIterations = numOneRingDilationIterations;
+    simulation.m_dilationRadius               = dilationRadius;
+    simulation.m_dilationMetric =
+        euclideanDilation ? locremesh::DilationMetric::Euclidean
+                          : locremesh::DilationMetric::Geodesic;
+    simulation.m_autoRemeshing                = autoRemeshing;
+    simulation.m_autoParametrization          = autoParametrization;
+    simulation.m_localParametrization         = localParametrization;
+    simulation.m_numLocalParametrizationRings = numLocalParamRings;
+    simulation.setStageTimer(&stageTimer);
+
+    // Fixed timestep loop /////////////////////////////////////////////////////
+    const double dt            = 1.f / updatesPerSecond;
+    double       simulatedTime = 0.0;
+    for (int step = 0; step < numSteps; ++step) {
+        simulatedTime += dt;
+        std::cout << "Step " << step + 1 << "/" << numSteps << std::endl;
+        simulation.step(simulatedTime);
+    }
+
+    // Output //////////////////////////////////////////////////////////////////
+    if (!igl::writeOBJ(outputMeshFilename,
+                       inputMesh->getVertices(),
+                       inputMesh->getFaces(),
+                       Eigen::MatrixXd(),
+                       Eigen::MatrixXi(),
+                       inputMesh->getUVCoords(),
+                       inputMesh->getFaces())) {
+        std::cerr << "Could not write " << outputMeshFilename << std::endl;
+        return 1;
+    }
+
+    std::ofstream timingsFile(timingsFilename);
+    if (!timingsFile) {
+        std::cerr << "Could not write " << timingsFilename << std::endl;
+        return 1;
+    }
+    timingsFile << "{\n"
+                << "  \"mesh\": \"" << inputMeshFilename << "\",\n"
+                << "  \"steps\": " << numSteps << ",\n"
+                << "  \"threads\": " << numThreads << ",\n"
+                << "  \"final_vertices\": " << inputMesh->getVertexCount()
+                << ",\n"
+                << "  \"final_faces\": " << inputMesh->getFaceCount() << ",\n"
+                << "  \"stages\": ";
+    stageTimer.writeJSON(timingsFile, "  ");
+    timingsFile << "\n}\n";
+
+    std::cout << "Wrote " << outputMeshFilename << " and " << timingsFilename
+              << std::endl;
+    return 0;
+}
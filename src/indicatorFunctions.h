@@ -4,8 +4,6 @@
 #include "igl/face_areas.h"
 #include "igl/igl_inline.h"
 #include "igl/read_triangle_mesh.h"
-#include "polyscope/point_cloud.h"
-#include "polyscope/surface_mesh.h"
 #include "remesh/src/remesh_botsch.h"
 
 #include <Eigen/Core>
@@ -24,4 +22,33 @@ namespace locremesh {  /////////////////////////////////////////////////////////
 Eigen::VectorXd indFuncTriangleQuality(const Eigen::MatrixXd& meshVertices,
                                        const Eigen::MatrixXi& meshFaces);
 
+/**
+ * Batched variant of the triangle quality metric. The corners of a block of
+ * faces are gathered into structure-of-arrays lanes so that the metric is
+ * evaluated for several faces per SIMD instruction, and the blocks can be
+ * spread over several threads. Every face goes through the same operations,
+ * in the same order, as in the per-face version, and the native build keeps
+ * them from being contracted into FMAs, so the values are bitwise identical
+ * to those of triangleQuality().
+ *
+ * @param numThreads Number of threads working on the face blocks. Ignored
+ * when built without OpenMP.
+ */
+Eigen::VectorXd indFuncTriangleQualityBatched(
+    const Eigen::MatrixXd& meshVertices,
+    const Eigen::MatrixXi& meshFaces,
+    int                    numThreads = 1);
+
+/**
+ * Incremental variant of the triangle quality metric: recomputes the quality
+ * of the given faces in place and leaves every other entry untouched.
+ *
+ * @param faceIdxs The faces whose quality must be recomputed.
+ * @param quality The per-face quality, already sized to the number of faces.
+ */
+void indFuncTriangleQuality(const Eigen::MatrixXd&  meshVertices,
+                            const Eigen::MatrixXi&  meshFaces,
+                            const std::vector<int>& faceIdxs,
+                            Eigen::VectorXd&        quality);
+
 };  // namespace locremesh
@@ -12,6 +12,7 @@
 #include "botschRemesher.h"
 #include "indicatorFunctions.h"
 #include "mesh.h"
+#include "simulation.h"
 #include "utils.h"
 #include "vertexSelector.h"
 
@@ -48,18 +49,17 @@ int main(int argc, char* argv[])
     locremesh::BotschRemesher botschRemesher(
         vertexSelector, defaultTargetEdgeLength, defaultNumIterations, true);
 
+    // The Simulation runs one fixed timestep of the deform, select, remesh
+    // and parametrize pipeline. It is shared with the headless driver.
+    locremesh::Simulation simulation(inputMesh, vertexSelector, botschRemesher);
+
     // Polyscope Callback //////////////////////////////////////////////////////
     // Physics simulation variables
-    float  spatialFrequency             = 15.f;
-    float  updatesPerSecond             = 50.f;
-    float  amplitude                    = 0.1f;
-    int    numMaxParamIterations        = 15;
-    int    numOneRingDilationIterations = 5;
-    bool   autoRemeshing                = false;
-    bool   autoParametrization          = false;
-    bool   runDeformation               = false;
-    double accumulator                  = 0.0;
-    double simulatedTime                = 0.0;
+    float  updatesPerSecond      = 50.f;
+    int    numMaxParamIterations = 15;
+    bool   runDeformation        = false;
+    double accumulator           = 0.0;
+    double simulatedTime         = 0.0;
 
     polyscope::state::userCallback = [&]() {
         double dt = 1.f / updatesPerSecond;
@@ -72,17 +72,32 @@ int main(int argc, char* argv[])
         ImGui::Text("Deformation");
         ImGui::Checkbox("Run sinewave deformation", &runDeformation);
         ImGui::SliderFloat("Updates per second", &updatesPerSecond, 1.f, 100.f);
-        ImGui::SliderFloat("Spatial Frequency", &spatialFrequency, 0.f, 100.f);
-        ImGui::SliderFloat("Amplitude", &amplitude, 0.f, 1.f);
-
-        ImGui::Checkbox("Auto Remesh", &autoRemeshing);
-        ImGui::Checkbox("Auto Parametrization", &autoParametrization);
+        ImGui::SliderFloat(
+            "Spatial Frequency", &simulation.m_spatialFrequency, 0.f, 100.f);
+        ImGui::SliderFloat("Amplitude", &simulation.m_amplitude, 0.f, 1.f);
+
+        ImGui::Checkbox("Auto Remesh", &simulation.m_autoRemeshing);
+        ImGui::Checkbox("Auto Parametrization",
+                        &simulation.m_autoParametrization);
+        ImGui::Checkbox("Local Parametrization after Remesh",
+                        &simulation.m_localParametrization);
         if (ImGui::SliderInt(
                 "Max Param Iterations", &numMaxParamIterations, 1, 15)) {
             inputMesh.setParamatrizationIterations(numMaxParamIterations);
         }
-        ImGui::SliderInt(
-            "One-ring Dilation degree", &numOneRingDilationIterations, 1, 10);
+        ImGui::SliderInt("One-ring Dilation degree",
+                         &simulation.m_numOneRingDilationIterations,
+                         1,
+                         10);
+        ImGui::SliderFloat(
+            "Dilation Radius (0 = off)", &simulation.m_dilationRadius, 0.f, 1.f);
+        bool euclideanDilation =
+            simulation.m_dilationMetric == locremesh::DilationMetric::Euclidean;
+        if (ImGui::Checkbox("Euclidean Dilation Radius", &euclideanDilation)) {
+            simulation.m_dilationMetric =
+                euclideanDilation ? locremesh::DilationMetric::Euclidean
+                                  : locremesh::DilationMetric::Geodesic;
+        }
 
         // The accumulator is used to ensure that the physics simulation is
         // updated at a fixed rate, regardless of the frame rate.
@@ -92,35 +107,7 @@ int main(int argc, char* argv[])
             // Here is where the simulation will take place.
             std::cout << "Update timestep: " << accumulator << std::endl;
 
-            if (autoRemeshing) {
-                // Run remeshing for selected vertices in the previous update.
-                botschRemesher.remesh();
-                inputMesh.calculateUVParametrization(false);
-            }
-
-            // While the mass-spring simulation isn't ready, we move the mesh
-            // by going through the vertices and updating their z position
-            // according to a sine function
-            Eigen::MatrixXd newVertices = inputMesh.getVertices();
-            for (int i = 0; i < newVertices.rows(); ++i) {
-                newVertices(i, 2) =
-                    amplitude * std::sin(newVertices(i, 0) * spatialFrequency +
-                                         simulatedTime / 1.5);
-            }
-
-            inputMesh.updateVertexPositions(newVertices);
-            inputMesh.calculateMeshQuality();
-
-            if (autoRemeshing) {
-                vertexSelector.selectVerticesBasedOnQuality();
-                for (int i = 0; i < numOneRingDilationIterations; ++i) {
-                    vertexSelector.applyOneRingDilation();
-                }
-            }
-
-            if (autoParametrization && !autoRemeshing) {
-                inputMesh.calculateUVParametrization(true);
-            }
+            simulation.step(simulatedTime);
 
             // Re-register the entire polyscope surface. (Not ideal but will do
             // for now)
@@ -1,8 +1,106 @@
 #include "mesh.h"
+#include "igl/barycentric_coordinates.h"
+#include "igl/point_mesh_squared_distance.h"
 #include "param.h"
 
+// Polyscope, which the core does not link, used to provide stb_image. The
+// copy compiled here is static so that it does not clash with it in the viewer
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
 namespace locremesh {
 
+namespace {
+
+bool hasFlippedUVTriangles(const Eigen::MatrixXd& uvCoords,
+                           const Eigen::MatrixXi& faces)
+{
+    for (int i = 0; i < faces.rows(); ++i) {
+        Eigen::RowVector2d e1 =
+            uvCoords.row(faces(i, 1)) - uvCoords.row(faces(i, 0));
+        Eigen::RowVector2d e2 =
+            uvCoords.row(faces(i, 2)) - uvCoords.row(faces(i, 0));
+        if (e1.x() * e2.y() - e1.y() * e2.x() <= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Interpolates a per-vertex attribute of the given mesh at the points, using
+ * their closest points on it.
+ */
+Eigen::MatrixXd interpolateVertexAttribute(const Eigen::MatrixXd& vertices,
+                                           const Eigen::MatrixXi& faces,
+                                           const Eigen::MatrixXd& attribute,
+                                           const Eigen::MatrixXd& points)
+{
+    Eigen::VectorXd squaredDistances;
+    Eigen::VectorXi closestFaces;
+    Eigen::MatrixXd closestPoints;
+    igl::point_mesh_squared_distance(
+        points, vertices, faces, squaredDistances, closestFaces, closestPoints);
+
+    Eigen::MatrixXd a(points.rows(), 3), b(points.rows(), 3),
+        c(points.rows(), 3);
+    for (int i = 0; i < points.rows(); ++i) {
+        a.row(i) = vertices.row(faces(closestFaces[i], 0));
+        b.row(i) = vertices.row(faces(closestFaces[i], 1));
+        c.row(i) = vertices.row(faces(closestFaces[i], 2));
+    }
+    Eigen::MatrixXd barycentric;
+    igl::barycentric_coordinates(closestPoints, a, b, c, barycentric);
+
+    Eigen::MatrixXd interpolated(points.rows(), attribute.cols());
+    for (int i = 0; i < points.rows(); ++i) {
+        interpolated.row(i).setZero();
+        for (int j = 0; j < 3; ++j) {
+            interpolated.row(i) +=
+                barycentric(i, j) * attribute.row(faces(closestFaces[i], j));
+        }
+    }
+    return interpolated;
+}
+
+}  // namespace
+
+Mesh& Mesh::operator=(const Mesh& other)
+{
+    if (this == &other) {
+        return *this;
+    }
+    m_polyscopeID               = other.m_polyscopeID;
+    m_vertices                  = other.m_vertices;
+    m_restVertices              = other.m_restVertices;
+    m_faces                     = other.m_faces;
+    m_quality                   = other.m_quality;
+    m_uvCoords                  = other.m_uvCoords;
+    m_uvOffset                  = other.m_uvOffset;
+    m_uvScale                   = other.m_uvScale;
+    m_staleUVVertices           = other.m_staleUVVertices;
+    m_boundaryBitMask           = other.m_boundaryBitMask;
+    m_connectivity              = other.m_connectivity;
+    m_dirtyVertices             = other.m_dirtyVertices;
+    m_changedQualityFaces       = other.m_changedQualityFaces;
+    m_allQualityChanged         = other.m_allQualityChanged;
+    m_parametrizationIterations = other.m_parametrizationIterations;
+    m_numThreads                = other.m_numThreads;
+    m_textureWidth              = other.m_textureWidth;
+    m_textureHeight             = other.m_textureHeight;
+    m_textureChannels           = other.m_textureChannels;
+    m_textureColor              = other.m_textureColor;
+    m_parametrizer.reset();
+    return *this;
+}
+
+void Mesh::ParametrizerDeleter::operator()(
+    Parametrizer<double>* parametrizer) const
+{
+    delete parametrizer;
+}
+
 void Mesh::loadTexture(std::string textureFilename)
 {
     if (!textureFilename.empty()) {
@@ -20,19 +118,21 @@ void Mesh::loadTexture(std::string textureFilename)
             return;
         }
 
-        m_textureColor.resize(m_textureWidth * m_textureHeight);
+        auto textureColor = std::make_shared<std::vector<std::array<float, 3>>>(
+            m_textureWidth * m_textureHeight);
 
         for (int j = 0; j < m_textureHeight; j++) {
             for (int i = 0; i < m_textureWidth; i++) {
                 int pix_ind = (j * m_textureWidth + i) * m_textureChannels;
 
-                m_textureColor[j * m_textureWidth + i] = {
+                (*textureColor)[j * m_textureWidth + i] = {
                     data[pix_ind + 0] / 255.f,
                     data[pix_ind + 1] / 255.f,
                     data[pix_ind + 2] / 255.f};
             }
         }
         stbi_image_free(data);
+        m_textureColor = std::move(textureColor);
     }
 }
 
@@ -40,43 +140,15 @@ void Mesh::updateVertexPositions(Eigen::MatrixXd& newVertices)
 {
     assert(newVertices.rows() == m_vertices.rows() &&
            newVertices.cols() == m_vertices.cols());
-    m_vertices = newVertices;
-}
 
-polyscope::SurfaceMesh* Mesh::polyscopeRegisterSurfaceMesh()
-{
-    assert(m_quality.size() == m_faces.rows());  // Quality has been calculated
-    assert(m_uvCoords.rows() == m_vertices.rows() && m_uvCoords.cols() == 2);
-
-    if (polyscope::hasSurfaceMesh(m_polyscopeID)) {
-        polyscope::removeSurfaceMesh(m_polyscopeID);
-    }
-
-    auto psSurfaceMesh =
-        polyscope::registerSurfaceMesh(m_polyscopeID, m_vertices, m_faces);
-
-    // Add Triangle Quality
-    auto psFaceScalar =
-        psSurfaceMesh->addFaceScalarQuantity("Triangle Quality", m_quality);
-    psFaceScalar->setMapRange(std::make_pair<int, int>(0, 1));
-
-    // Add Parametrization
-    auto psVertexParam =
-        psSurfaceMesh->addVertexParameterizationQuantity("UV Map", m_uvCoords);
-
-    // Add texture
-    if (!m_textureColor.empty()) {
-        auto psTextureColor = psSurfaceMesh->addTextureColorQuantity(
-            "Texture",
-            *psVertexParam,
-            m_textureWidth,
-            m_textureHeight,
-            m_textureColor,
-            polyscope::ImageOrigin::LowerLeft);
-        psTextureColor->setEnabled(true);
+    // Remember which vertices actually moved so that updateMeshQuality() only
+    // has to revisit the faces around them.
+    for (int i = 0; i < m_vertices.rows(); ++i) {
+        if (m_vertices.row(i) != newVertices.row(i)) {
+            m_dirtyVertices.push_back(i);
+        }
     }
-
-    return psSurfaceMesh;
+    m_vertices = newVertices;
 }
 
 void Mesh::identifyBoundaryVertices()
@@ -92,12 +164,16 @@ void Mesh::identifyBoundaryVertices()
 void Mesh::calculateUVParametrization(bool useCurrentUV)
 {
     std::cout << "Calculating UV parametrization..." << std::endl;
+    if (!m_parametrizer) {
+        m_parametrizer.reset(new Parametrizer<double>());
+    }
+    m_parametrizer->setNumThreads(m_numThreads);
     if (useCurrentUV) {
-        m_uvCoords = param<double>(
+        m_uvCoords = m_parametrizer->solve(
             m_vertices, m_faces, m_uvCoords, m_parametrizationIterations);
     } else {
         Eigen::MatrixXd emptyUV;
-        m_uvCoords = param<double>(
+        m_uvCoords = m_parametrizer->solve(
             m_vertices, m_faces, emptyUV, m_parametrizationIterations);
     }
 
@@ -119,27 +195,384 @@ void Mesh::calculateUVParametrization(bool useCurrentUV)
     m_uvCoords.col(0) = (m_uvCoords.col(0).array() - uv_min.x()) / uv_range.x();
     m_uvCoords.col(1) = (m_uvCoords.col(1).array() - uv_min.y()) / uv_range.y();
 
+    // Kept so that local updates can solve in the unnormalized space
+    m_uvOffset = uv_min.transpose();
+    m_uvScale  = uv_range.transpose();
+    m_staleUVVertices.clear();
+
     std::cout << "Finished calculating UV parametrization" << std::endl;
 }
 
+/**
+ * Re-optimizes the UVs around the vertices created by the last
+ * replaceRegions() only. The stale vertices and numRingIterations rings
+ * around them are free, every other vertex keeps its UVs, so the cost scales
+ * with the size of the remeshed patches.
+ *
+ * Falls back to calculateUVParametrization(false) when the UVs do not match
+ * the mesh (e.g. after a global remesh) or the local solve leaves flipped
+ * triangles behind.
+ */
+void Mesh::calculateUVParametrizationLocally(int numRingIterations)
+{
+    if (m_uvCoords.rows() != m_vertices.rows()) {
+        calculateUVParametrization(false);
+        return;
+    }
+    if (m_staleUVVertices.empty()) {
+        return;
+    }
+
+    std::cout << "Calculating local UV parametrization..." << std::endl;
+    const MeshConnectivity& connectivity = getConnectivity();
+
+    std::vector<bool> freeBitMask(m_vertices.rows(), false);
+    std::vector<int>  freeIdxs = m_staleUVVertices;
+    for (int v : freeIdxs) {
+        freeBitMask[v] = true;
+    }
+    for (int ring = 0, begin = 0; ring < numRingIterations; ++ring) {
+        const int end = freeIdxs.size();
+        for (int k = begin; k < end; ++k) {
+            for (int neighbor : connectivity.getVertexNeighbors(freeIdxs[k])) {
+                if (!freeBitMask[neighbor]) {
+                    freeBitMask[neighbor] = true;
+                    freeIdxs.push_back(neighbor);
+                }
+            }
+        }
+        begin = end;
+    }
+
+    // The local problem holds every face touching a free vertex, its other
+    // corners are fixed and anchor the patch in the surrounding UVs
+    std::vector<int> localFaceIdxs;
+    for (int v : freeIdxs) {
+        for (int f : connectivity.getVertexFaces(v)) {
+            localFaceIdxs.push_back(f);
+        }
+    }
+    std::sort(localFaceIdxs.begin(), localFaceIdxs.end());
+    localFaceIdxs.erase(std::unique(localFaceIdxs.begin(), localFaceIdxs.end()),
+                        localFaceIdxs.end());
+
+    std::vector<int> localVertexIdxs;
+    for (int f : localFaceIdxs) {
+        for (int j = 0; j < 3; ++j) {
+            localVertexIdxs.push_back(m_faces(f, j));
+        }
+    }
+    std::sort(localVertexIdxs.begin(), localVertexIdxs.end());
+    localVertexIdxs.erase(
+        std::unique(localVertexIdxs.begin(), localVertexIdxs.end()),
+        localVertexIdxs.end());
+
+    const int         numLocalVertices = localVertexIdxs.size();
+    Eigen::MatrixXd   localVertices(numLocalVertices, 3);
+    Eigen::MatrixXd   localUV(numLocalVertices, 2);
+    std::vector<bool> fixedBitMask(numLocalVertices);
+    for (int i = 0; i < numLocalVertices; ++i) {
+        const int v         = localVertexIdxs[i];
+        localVertices.row(i) = m_vertices.row(v);
+        localUV.row(i) =
+            m_uvCoords.row(v).cwiseProduct(m_uvScale) + m_uvOffset;
+        fixedBitMask[i] = !freeBitMask[v];
+    }
+    Eigen::MatrixXi localFaces(localFaceIdxs.size(), 3);
+    for (int i = 0; i < localFaceIdxs.size(); ++i) {
+        for (int j = 0; j < 3; ++j) {
+            localFaces(i, j) =
+                std::lower_bound(localVertexIdxs.begin(),
+                                 localVertexIdxs.end(),
+                                 m_faces(localFaceIdxs[i], j)) -
+                localVertexIdxs.begin();
+        }
+    }
+
+    const int numFixed =
+        std::count(fixedBitMask.begin(), fixedBitMask.end(), true);
+    if (numFixed == 0) {
+        calculateUVParametrization(false);
+        return;
+    }
+
+    // The energy is infinite on flipped triangles, so an interpolated start
+    // that flips is replaced by the harmonic extension of the fixed UVs
+    if (hasFlippedUVTriangles(localUV, localFaces)) {
+        Eigen::VectorXi fixedIdxs(numFixed);
+        Eigen::MatrixXd fixedUV(numFixed, 2);
+        for (int i = 0, k = 0; i < numLocalVertices; ++i) {
+            if (fixedBitMask[i]) {
+                fixedIdxs[k] = i;
+                fixedUV.row(k++) = localUV.row(i);
+            }
+        }
+        Eigen::MatrixXd harmonicUV;
+        if (!igl::harmonic(localFaces, fixedIdxs, fixedUV, 1, harmonicUV) ||
+            hasFlippedUVTriangles(harmonicUV, localFaces)) {
+            std::cout << "Local UV initialization failed" << std::endl;
+            calculateUVParametrization(false);
+            return;
+        }
+        localUV = harmonicUV;
+    }
+
+    Parametrizer<double> localParametrizer;
+    localParametrizer.setNumThreads(m_numThreads);
+    Eigen::MatrixXd      optimizedUV = localParametrizer.solve(
+        localVertices,
+        localFaces,
+        localUV,
+        m_parametrizationIterations,
+        fixedBitMask);
+    if (!optimizedUV.allFinite() ||
+        hasFlippedUVTriangles(optimizedUV, localFaces)) {
+        std::cout << "Local UV parametrization failed" << std::endl;
+        calculateUVParametrization(false);
+        return;
+    }
+
+    for (int i = 0; i < numLocalVertices; ++i) {
+        if (!fixedBitMask[i]) {
+            m_uvCoords.row(localVertexIdxs[i]) =
+                (optimizedUV.row(i) - m_uvOffset).cwiseQuotient(m_uvScale);
+        }
+    }
+    m_staleUVVertices.clear();
+
+    std::cout << "Finished calculating local UV parametrization" << std::endl;
+}
+
+/**
+ * Interpolates a per-vertex attribute of the faces the patch was cut from at
+ * the given points, using the closest point on those faces.
+ */
+Eigen::MatrixXd Mesh::interpolateFromPatch(const Submesh&         patch,
+                                           const Eigen::MatrixXd& attribute,
+                                           const Eigen::MatrixXd& points) const
+{
+    Eigen::MatrixXi patchFaces(patch.parentFaceIdxs.size(), 3);
+    for (int i = 0; i < patch.parentFaceIdxs.size(); ++i) {
+        patchFaces.row(i) = m_faces.row(patch.parentFaceIdxs[i]);
+    }
+    return interpolateVertexAttribute(m_vertices, patchFaces, attribute, points);
+}
+
+/**
+ * Carries a per-vertex attribute over to the mesh stitched by
+ * replaceRegions(). Untouched vertices keep their values, the active vertices
+ * of the patches, which come last in patch order, are interpolated from the
+ * region they replaced.
+ */
+Eigen::MatrixXd Mesh::stitchVertexAttribute(
+    const StitchMap&            map,
+    const std::vector<Submesh>& patches,
+    const Eigen::MatrixXd&      attribute) const
+{
+    Eigen::MatrixXd stitched(map.vertexSource.size(), attribute.cols());
+    for (int i = 0; i < map.vertexSource.size(); ++i) {
+        if (map.vertexSource[i] >= 0) {
+            stitched.row(i) = attribute.row(map.vertexSource[i]);
+        }
+    }
+
+    int vertexOffset = map.vertexSource.size();
+    for (const Submesh& patch : patches) {
+        vertexOffset -= patch.vertices.rows() - patch.numFrozenVertices;
+    }
+    for (const Submesh& patch : patches) {
+        const int numActive = patch.vertices.rows() - patch.numFrozenVertices;
+        stitched.middleRows(vertexOffset, numActive) = interpolateFromPatch(
+            patch, attribute, patch.vertices.bottomRows(numActive));
+        vertexOffset += numActive;
+    }
+    return stitched;
+}
+
+/**
+ * Gives the vertices of a mesh remeshed as a whole their rest positions, by
+ * interpolating the rest shape of the mesh before the remesh at their closest
+ * points on it.
+ */
+void Mesh::transferRestVertices(const Eigen::MatrixXd& previousVertices,
+                                const Eigen::MatrixXi& previousFaces)
+{
+    if (m_restVertices.rows() != previousVertices.rows()) {
+        m_restVertices = m_vertices;
+        return;
+    }
+    m_restVertices = interpolateVertexAttribute(
+        previousVertices, previousFaces, m_restVertices, m_vertices);
+}
+
 void Mesh::calculateMeshQuality()
 {
-    m_quality = indFuncTriangleQuality(m_vertices, m_faces);
+    m_quality =
+        indFuncTriangleQualityBatched(m_vertices, m_faces, m_numThreads);
+    m_dirtyVertices.clear();
+    m_changedQualityFaces.clear();
+    m_allQualityChanged = true;
+}
+
+/**
+ * Brings the quality up to date with the vertices moved through
+ * updateVertexPositions() since the last update. Falls back to the full
+ * recompute when the quality is stale or most of the mesh moved anyway.
+ */
+void Mesh::updateMeshQuality()
+{
+    if (m_quality.size() != m_faces.rows() ||
+        2 * m_dirtyVertices.size() > m_vertices.rows()) {
+        calculateMeshQuality();
+        return;
+    }
+
+    std::sort(m_dirtyVertices.begin(), m_dirtyVertices.end());
+    m_dirtyVertices.erase(
+        std::unique(m_dirtyVertices.begin(), m_dirtyVertices.end()),
+        m_dirtyVertices.end());
+    updateMeshQualityAroundVertices(m_dirtyVertices);
+    m_dirtyVertices.clear();
+}
+
+/**
+ * Recomputes the quality of the given faces only.
+ */
+void Mesh::updateMeshQuality(const std::vector<int>& dirtyFaceIdxs)
+{
+    if (m_quality.size() != m_faces.rows()) {
+        calculateMeshQuality();
+        return;
+    }
+    indFuncTriangleQuality(m_vertices, m_faces, dirtyFaceIdxs, m_quality);
+
+    // Past the number of faces, walking the list costs more than a full pass
+    if (!m_allQualityChanged) {
+        m_changedQualityFaces.insert(m_changedQualityFaces.end(),
+                                     dirtyFaceIdxs.begin(),
+                                     dirtyFaceIdxs.end());
+        if (m_changedQualityFaces.size() > m_faces.rows()) {
+            m_changedQualityFaces.clear();
+            m_allQualityChanged = true;
+        }
+    }
+}
+
+/**
+ * Recomputes the quality of every face incident to the given vertices.
+ */
+void Mesh::updateMeshQualityAroundVertices(
+    const std::vector<int>& dirtyVertexIdxs)
+{
+    const MeshConnectivity& connectivity = getConnectivity();
+
+    std::vector<int> dirtyFaceIdxs;
+    for (int v : dirtyVertexIdxs) {
+        for (int f : connectivity.getVertexFaces(v)) {
+            dirtyFaceIdxs.push_back(f);
+        }
+    }
+    std::sort(dirtyFaceIdxs.begin(), dirtyFaceIdxs.end());
+    dirtyFaceIdxs.erase(std::unique(dirtyFaceIdxs.begin(), dirtyFaceIdxs.end()),
+                        dirtyFaceIdxs.end());
+
+    updateMeshQuality(dirtyFaceIdxs);
+}
+
+/**
+ * Must be called whenever m_faces is modified, e.g. after remeshing, so that
+ * the connectivity derived from it is rebuilt on the next access.
+ */
+void Mesh::notifyTopologyChanged()
+{
+    m_connectivity.clear();
+    m_dirtyVertices.clear();
+    m_staleUVVertices.clear();
+    m_parametrizer.reset();
+    m_changedQualityFaces.clear();
+    m_allQualityChanged = true;
+}
+
+/**
+ * Marks the quality as seen, getChangedQualityFaces() then only collects the
+ * faces updated from now on.
+ */
+void Mesh::clearQualityChanges()
+{
+    m_changedQualityFaces.clear();
+    m_allQualityChanged = false;
 }
 
-std::set<int> Mesh::getVertexNeighbors(int vertexIdx)
+/**
+ * Replaces the regions covered by the remeshed patches and updates every
+ * per-vertex and per-face attribute accordingly.
+ *
+ * @param patches Patches obtained from extractSubmesh() on this mesh, after
+ * they have been remeshed.
+ * @return The mapping of the new vertices and faces to the previous ones.
+ */
+StitchMap Mesh::replaceRegions(const std::vector<Submesh>& patches)
 {
-    std::set<int> neighbors;
-    for (int i = 0; i < m_faces.rows(); ++i) {
-        for (int j = 0; j < m_faces.cols(); ++j) {
-            if (m_faces(i, j) == vertexIdx) {
-                // Found the vertex in this face, add its neighbors in the face
-                neighbors.insert(m_faces(i, (j + 1) % 3));
-                neighbors.insert(m_faces(i, (j + 2) % 3));
+    // Flush pending vertex moves, their indices are about to change
+    updateMeshQuality();
+
+    Eigen::MatrixXd stitchedVertices;
+    Eigen::MatrixXi stitchedFaces;
+    StitchMap       map = stitchSubmeshes(
+        m_vertices, m_faces, patches, stitchedVertices, stitchedFaces);
+
+    // Untouched vertices keep their UVs and rest positions, remeshed ones are
+    // interpolated from the patch they replaced and their UVs are marked for
+    // the next local parametrization.
+    std::vector<int> staleUVVertices;
+    if (m_uvCoords.rows() == m_vertices.rows()) {
+        m_uvCoords = stitchVertexAttribute(map, patches, m_uvCoords);
+        for (int i = 0; i < map.vertexSource.size(); ++i) {
+            if (map.vertexSource[i] < 0) {
+                staleUVVertices.push_back(i);
             }
         }
     }
-    return neighbors;
+    if (m_restVertices.rows() == m_vertices.rows()) {
+        m_restVertices = stitchVertexAttribute(map, patches, m_restVertices);
+    } else {
+        m_restVertices = stitchedVertices;
+    }
+
+    // Faces outside the patches kept their corners, so only the remeshed
+    // ones need a new quality value.
+    Eigen::VectorXd  quality(stitchedFaces.rows());
+    std::vector<int> newFaceIdxs;
+    for (int i = 0; i < map.faceSource.size(); ++i) {
+        if (map.faceSource[i] >= 0 && m_quality.size() == m_faces.rows()) {
+            quality[i] = m_quality[map.faceSource[i]];
+        } else {
+            newFaceIdxs.push_back(i);
+        }
+    }
+
+    m_vertices = std::move(stitchedVertices);
+    m_faces    = std::move(stitchedFaces);
+    m_quality  = std::move(quality);
+    notifyTopologyChanged();
+    identifyBoundaryVertices();
+    updateMeshQuality(newFaceIdxs);
+    m_staleUVVertices = std::move(staleUVVertices);
+
+    return map;
+}
+
+const MeshConnectivity& Mesh::getConnectivity()
+{
+    if (!m_connectivity.isBuilt()) {
+        m_connectivity.build(m_faces, m_vertices.rows());
+    }
+    return m_connectivity;
+}
+
+std::span<const int> Mesh::getVertexNeighbors(int vertexIdx)
+{
+    return getConnectivity().getVertexNeighbors(vertexIdx);
 }
 
 };  // namespace locremesh
\ No newline at end of file
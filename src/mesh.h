@@ -3,11 +3,20 @@
 #include <Eigen/Core>
 #include <exception>
 #include <iostream>
+#include <memory>
 
 #include "indicatorFunctions.h"
-#include "stb_image.h"
+#include "meshConnectivity.h"
+#include "submesh.h"
 #include "utils.h"
 
+template <typename PassiveT>
+class Parametrizer;
+
+namespace polyscope {
+class SurfaceMesh;
+}
+
 namespace locremesh {
 
 class Mesh
@@ -24,6 +33,7 @@ class Mesh
             throw std::runtime_error("Could not load mesh from " +
                                      meshFilename);
         }
+        m_restVertices = m_vertices;
         if (!textureFilename.empty()) {
             loadTexture(textureFilename);
         }
@@ -32,21 +42,35 @@ class Mesh
         identifyBoundaryVertices();
     }
 
-    Mesh(const Eigen::MatrixXd& vertices, const Eigen::MatrixXi& faces)
-        : m_vertices(vertices), m_faces(faces)
+    Mesh(const Eigen::MatrixXd& vertices,
+         const Eigen::MatrixXi& faces,
+         bool                   parametrize = true)
+        : m_vertices(vertices), m_restVertices(vertices), m_faces(faces)
     {
         calculateMeshQuality();
-        calculateUVParametrization();
+        if (parametrize) {
+            calculateUVParametrization();
+        }
         identifyBoundaryVertices();
     }
 
     Mesh(const Mesh& other)
-        : m_polyscopeID(other.m_polyscopeID),
-          m_vertices(other.m_vertices),
+        : m_vertices(other.m_vertices),
+          m_restVertices(other.m_restVertices),
           m_faces(other.m_faces),
           m_quality(other.m_quality),
           m_uvCoords(other.m_uvCoords),
           m_boundaryBitMask(other.m_boundaryBitMask),
+          m_uvOffset(other.m_uvOffset),
+          m_uvScale(other.m_uvScale),
+          m_staleUVVertices(other.m_staleUVVertices),
+          m_connectivity(other.m_connectivity),
+          m_dirtyVertices(other.m_dirtyVertices),
+          m_changedQualityFaces(other.m_changedQualityFaces),
+          m_allQualityChanged(other.m_allQualityChanged),
+          m_polyscopeID(other.m_polyscopeID),
+          m_parametrizationIterations(other.m_parametrizationIterations),
+          m_numThreads(other.m_numThreads),
           m_textureWidth(other.m_textureWidth),
           m_textureHeight(other.m_textureHeight),
           m_textureChannels(other.m_textureChannels),
@@ -54,14 +78,33 @@ class Mesh
     {
     }
 
+    // Leaves the parametrizer behind, it is rebuilt on demand
+    Mesh& operator=(const Mesh& other);
+
+    // Moves keep the parametrizer along with the faces it was built for
+    Mesh(Mesh&& other) noexcept            = default;
+    Mesh& operator=(Mesh&& other) noexcept = default;
+
     void loadTexture(std::string textureFilename);
     void calculateMeshQuality();
+    void updateMeshQuality();
+    void updateMeshQuality(const std::vector<int>& dirtyFaceIdxs);
+    void updateMeshQualityAroundVertices(
+        const std::vector<int>& dirtyVertexIdxs);
     void calculateUVParametrization(bool useCurrentUV = true);
+    void calculateUVParametrizationLocally(int numRingIterations = 1);
     void identifyBoundaryVertices();
     void updateVertexPositions(Eigen::MatrixXd& newVertices);
+    void notifyTopologyChanged();
+    void clearQualityChanges();
+    StitchMap replaceRegions(const std::vector<Submesh>& patches);
+    void      transferRestVertices(const Eigen::MatrixXd& previousVertices,
+                                   const Eigen::MatrixXi& previousFaces);
 
+    // Defined in ui/, which only the viewer is built with
     polyscope::SurfaceMesh* polyscopeRegisterSurfaceMesh();
-    std::set<int>           getVertexNeighbors(int vertexIdx);
+    const MeshConnectivity& getConnectivity();
+    std::span<const int>    getVertexNeighbors(int vertexIdx);
 
     // Get methods
     // -------------------------------------------------------------
@@ -77,6 +120,10 @@ class Mesh
     {
         return m_vertices;
     }
+    const Eigen::MatrixXd& getRestVertices() const
+    {
+        return m_restVertices;
+    }
     const Eigen::MatrixXi& getFaces() const
     {
         return m_faces;
@@ -89,6 +136,10 @@ class Mesh
     {
         return m_boundaryBitMask;
     }
+    const Eigen::MatrixXd& getUVCoords() const
+    {
+        return m_uvCoords;
+    }
     Eigen::MatrixXd& getVertices()
     {
         return m_vertices;
@@ -105,6 +156,21 @@ class Mesh
     {
         return m_boundaryBitMask;
     }
+    // Faces whose quality was recomputed since the last
+    // clearQualityChanges(), possibly with repetitions. Only meaningful when
+    // haveAllQualitiesChanged() is false.
+    const std::vector<int>& getChangedQualityFaces() const
+    {
+        return m_changedQualityFaces;
+    }
+    bool haveAllQualitiesChanged() const
+    {
+        return m_allQualityChanged;
+    }
+    int getNumThreads() const
+    {
+        return m_numThreads;
+    }
     std::string getPolyscopeID() const
     {
         return m_polyscopeID;
@@ -118,27 +184,72 @@ class Mesh
     {
         m_parametrizationIterations = iterations;
     }
+    void setNumThreads(int numThreads)
+    {
+        m_numThreads = numThreads;
+    }
 
 
    private:
+    Eigen::MatrixXd interpolateFromPatch(const Submesh&         patch,
+                                         const Eigen::MatrixXd& attribute,
+                                         const Eigen::MatrixXd& points) const;
+    Eigen::MatrixXd stitchVertexAttribute(
+        const StitchMap&            map,
+        const std::vector<Submesh>& patches,
+        const Eigen::MatrixXd&      attribute) const;
+
     Eigen::MatrixXd   m_vertices;
+    // Undeformed positions of the vertices, the shape the strain is measured
+    // against. Remeshed vertices interpolate it from the region they replace.
+    Eigen::MatrixXd   m_restVertices;
     Eigen::MatrixXi   m_faces;
     Eigen::VectorXd   m_quality;
     Eigen::MatrixXd   m_uvCoords;
     std::vector<bool> m_boundaryBitMask;
 
+    // Normalization applied to the optimized UVs, uv = (raw - offset) / scale
+    Eigen::RowVector2d m_uvOffset = Eigen::RowVector2d::Zero();
+    Eigen::RowVector2d m_uvScale  = Eigen::RowVector2d::Ones();
+
+    // Vertices created by the last replaceRegions() whose UVs are only
+    // interpolated so far
+    std::vector<int> m_staleUVVertices;
+
+    // Connectivity, rebuilt lazily after every topology change
+    MeshConnectivity m_connectivity;
+
+    // Vertices moved since the quality was last brought up to date
+    std::vector<int> m_dirtyVertices;
+
+    // Faces whose quality changed since the last clearQualityChanges(), for
+    // consumers that only want to revisit those
+    std::vector<int> m_changedQualityFaces;
+    bool             m_allQualityChanged = true;
+
     // Polyscope
     std::string m_polyscopeID;
 
     // Parametrization
     int m_parametrizationIterations = 10;
 
-    // Texture
-    int m_textureWidth;
-    int m_textureHeight;
-    int m_textureChannels;
-    std::vector<std::array<float, 3>>
-        m_textureColor;  // The actual texture pixel data
+    // Reference geometry, energy and solver state reused by every
+    // parametrization until the faces change
+    struct ParametrizerDeleter
+    {
+        void operator()(Parametrizer<double>* parametrizer) const;
+    };
+    std::unique_ptr<Parametrizer<double>, ParametrizerDeleter> m_parametrizer;
+
+    // Threads used by the parallel kernels
+    int m_numThreads = 1;
+
+    // Texture. The pixels never change after loading, so copies of the mesh
+    // share them instead of duplicating the image.
+    int m_textureWidth    = 0;
+    int m_textureHeight   = 0;
+    int m_textureChannels = 0;
+    std::shared_ptr<const std::vector<std::array<float, 3>>> m_textureColor;
 };
 
 }  // namespace locremesh
\ No newline at end of file
@@ -0,0 +1,77 @@
+#include "meshConnectivity.h"
+
+#include <algorithm>
+
+namespace locremesh {
+
+void MeshConnectivity::build(const Eigen::MatrixXi& faces, int numVertices)
+{
+    const int numFaces = faces.rows();
+
+    // Vertex-to-face: count the incidences, prefix sum them into offsets and
+    // scatter the face indices. Faces are visited in order, so every row ends
+    // up sorted.
+    m_vertexFaceOffsets.assign(numVertices + 1, 0);
+    for (int i = 0; i < numFaces; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            m_vertexFaceOffsets[faces(i, j) + 1]++;
+        }
+    }
+    for (int v = 0; v < numVertices; ++v) {
+        m_vertexFaceOffsets[v + 1] += m_vertexFaceOffsets[v];
+    }
+
+    m_vertexFaces.resize(m_vertexFaceOffsets[numVertices]);
+    std::vector<int> cursor(m_vertexFaceOffsets.begin(),
+                            m_vertexFaceOffsets.end() - 1);
+    for (int i = 0; i < numFaces; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            m_vertexFaces[cursor[faces(i, j)]++] = i;
+        }
+    }
+
+    // Vertex-to-vertex: every incident face contributes its two other
+    // corners, which are then sorted and deduplicated in place. Interior
+    // vertices see every neighbor twice, boundary vertices once or twice.
+    std::vector<int> candidates(2 * m_vertexFaces.size());
+    m_vertexNeighborOffsets.assign(numVertices + 1, 0);
+    int numNeighbors = 0;
+    for (int v = 0; v < numVertices; ++v) {
+        const int begin = 2 * m_vertexFaceOffsets[v];
+        int       end   = begin;
+        for (int k = m_vertexFaceOffsets[v]; k < m_vertexFaceOffsets[v + 1];
+             ++k) {
+            const int f = m_vertexFaces[k];
+            for (int j = 0; j < 3; ++j) {
+                if (faces(f, j) != v) {
+                    candidates[end++] = faces(f, j);
+                }
+            }
+        }
+        std::sort(candidates.begin() + begin, candidates.begin() + end);
+        auto last = std::unique(candidates.begin() + begin,
+                                candidates.begin() + end);
+
+        // Compact towards the front; the write cursor never overtakes the
+        // read cursor because each vertex has at most 2 * valence candidates.
+        for (auto it = candidates.begin() + begin; it != last; ++it) {
+            candidates[numNeighbors++] = *it;
+        }
+        m_vertexNeighborOffsets[v + 1] = numNeighbors;
+    }
+    candidates.resize(numNeighbors);
+    m_vertexNeighbors = std::move(candidates);
+
+    m_isBuilt = true;
+}
+
+void MeshConnectivity::clear()
+{
+    m_vertexNeighborOffsets.clear();
+    m_vertexNeighbors.clear();
+    m_vertexFaceOffsets.clear();
+    m_vertexFaces.clear();
+    m_isBuilt = false;
+}
+
+}  // namespace locremesh
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <span>
+#include <vector>
+
+namespace locremesh {
+
+/**
+ * Compact vertex-to-vertex and vertex-to-face adjacency of a triangle mesh,
+ * stored in compressed sparse row (CSR) form.
+ *
+ * The structure is built once per topology change and then queried without
+ * any allocation: every query returns a view into the internal arrays.
+ */
+class MeshConnectivity
+{
+   public:
+    MeshConnectivity() = default;
+
+    void build(const Eigen::MatrixXi& faces, int numVertices);
+    void clear();
+
+    bool isBuilt() const
+    {
+        return m_isBuilt;
+    }
+
+    /**
+     * Returns the one-ring of a vertex, sorted by vertex index.
+     */
+    std::span<const int> getVertexNeighbors(int vertexIdx) const
+    {
+        return {m_vertexNeighbors.data() + m_vertexNeighborOffsets[vertexIdx],
+                m_vertexNeighbors.data() +
+                    m_vertexNeighborOffsets[vertexIdx + 1]};
+    }
+
+    /**
+     * Returns the faces incident to a vertex, sorted by face index.
+     */
+    std::span<const int> getVertexFaces(int vertexIdx) const
+    {
+        return {m_vertexFaces.data() + m_vertexFaceOffsets[vertexIdx],
+                m_vertexFaces.data() + m_vertexFaceOffsets[vertexIdx + 1]};
+    }
+
+    int getVertexCount() const
+    {
+        return m_vertexNeighborOffsets.empty()
+                   ? 0
+                   : m_vertexNeighborOffsets.size() - 1;
+    }
+
+   private:
+    std::vector<int> m_vertexNeighborOffsets;
+    std::vector<int> m_vertexNeighbors;
+    std::vector<int> m_vertexFaceOffsets;
+    std::vector<int> m_vertexFaces;
+    bool             m_isBuilt = false;
+};
+
+}  // namespace locremesh
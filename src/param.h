@@ -1,30 +1,159 @@
-#include <TinyAD/ScalarFunction.hh>
+#pragma once
+
+#include <Eigen/Eigenvalues>
+#include <TinyAD/Scalar.hh>
 #include <TinyAD/Utils/Helpers.hh>
 #include <TinyAD/Utils/LineSearch.hh>
 #include <TinyAD/Utils/NewtonDecrement.hh>
 #include <TinyAD/Utils/NewtonDirection.hh>
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include "TutteEmbeddingIGL.h"
 
+/**
+ * Minimizes the symmetric Dirichlet energy of a UV map, keeping everything
+ * that only depends on the connectivity alive between calls.
+ *
+ * The flattened reference triangles, the Hessian sparsity pattern with the
+ * slot of every element entry in it, and the linear solver (fill-reducing
+ * ordering and symbolic factorization) are built once per connectivity. Later
+ * calls only re-flatten the triangles whose vertices moved, so warm-started
+ * solves skip all setup work.
+ *
+ * Elements are evaluated in parallel into per-face slots and summed serially
+ * in face order, so the result does not depend on the number of threads.
+ */
 template <typename PassiveT>
-Eigen::Matrix<PassiveT, Eigen::Dynamic, 2> param(
-    const Eigen::MatrixXd& V,
-    const Eigen::MatrixXi& F,
-    Eigen::MatrixXd&       previousParam,
-    const int              numMaxIterations = 30)
+class Parametrizer
 {
-    if (previousParam.size() == 0) {
-        previousParam      = tutte_embedding(V, F);
+   public:
+    Parametrizer() = default;
+    Parametrizer(const Parametrizer&)            = delete;
+    Parametrizer& operator=(const Parametrizer&) = delete;
+
+    void setNumThreads(int numThreads)
+    {
+        m_numThreads = numThreads;
     }
 
-    // Define the local coordinates for ach triangle using the first vector and
-    // the normal to make coords.
-    std::vector<Eigen::Matrix<double, 2, 3>> flattened_ref_triangles;
-    flattened_ref_triangles.reserve(F.rows());
-    for (int i = 0; i < F.rows(); ++i) {
-        Eigen::Vector3d             a_r    = V.row(F(i, 0));
-        Eigen::Vector3d             b_r    = V.row(F(i, 1));
-        Eigen::Vector3d             c_r    = V.row(F(i, 2));
+    /**
+     * Drops all cached state, e.g. after the faces changed.
+     */
+    void clear()
+    {
+        m_hessian.resize(0, 0);
+        m_hessianSlots.clear();
+        m_faces.resize(0, 3);
+        m_referenceVertices.resize(0, 3);
+        m_flattenedRefTriangles.clear();
+
+        // An empty pattern never matches, which forces a new analysis
+        m_solver.sparsity_pattern.resize(0, 0);
+    }
+
+    /**
+     * @param V The vertices of the mesh.
+     * @param F The faces of the mesh.
+     * @param previousParam The UVs to start from, replaced by a Tutte
+     * embedding if empty.
+     * @param numMaxIterations The maximum number of Newton iterations.
+     * @param fixedBitMask Optional, one entry per vertex, true for the
+     * vertices whose UVs must keep their value from previousParam.
+     * @return The optimized UVs.
+     */
+    Eigen::Matrix<PassiveT, Eigen::Dynamic, 2> solve(
+        const Eigen::MatrixXd&   V,
+        const Eigen::MatrixXi&   F,
+        Eigen::MatrixXd&         previousParam,
+        const int                numMaxIterations = 30,
+        const std::vector<bool>& fixedBitMask     = {})
+    {
+        if (previousParam.size() == 0) {
+            previousParam = tutte_embedding(V, F);
+        }
+
+        if (m_hessianSlots.empty() || m_faces.rows() != F.rows() ||
+            m_referenceVertices.rows() != V.rows() || m_faces != F) {
+            setup(V, F);
+        } else {
+            updateReferenceTriangles(V);
+        }
+
+        m_x.resize(2 * V.rows());
+        for (int i = 0; i < V.rows(); ++i) {
+            m_x.template segment<2>(2 * i) =
+                previousParam.row(i).transpose().template cast<PassiveT>();
+        }
+
+        // Fixed vertices drop out of the Newton system, their entries of the
+        // search direction stay zero so the line search never moves them
+        m_dofToFreeDof.clear();
+        int numFreeDofs = 0;
+        if (!fixedBitMask.empty()) {
+            m_dofToFreeDof.resize(2 * V.rows());
+            for (int i = 0; i < V.rows(); ++i) {
+                for (int j = 0; j < 2; ++j) {
+                    m_dofToFreeDof[2 * i + j] =
+                        fixedBitMask[i] ? -1 : numFreeDofs++;
+                }
+            }
+        }
+
+        // Optimization step based off the defined function
+        int numIterations = 0;
+        for (int i = 0; i < numMaxIterations; ++i) {
+            const PassiveT f = evalWithHessianProj(m_x);
+            const Eigen::VectorX<PassiveT>&      g      = m_gradient;
+            const Eigen::SparseMatrix<PassiveT>& H_proj = m_hessian;
+            Eigen::VectorX<double>               d;
+            if (m_dofToFreeDof.empty()) {
+                d = TinyAD::newton_direction(g, H_proj, m_solver);
+            } else {
+                Eigen::VectorX<PassiveT>      freeG;
+                Eigen::SparseMatrix<PassiveT> freeH;
+                restrictToFreeDofs(g, H_proj, numFreeDofs, freeG, freeH);
+                Eigen::VectorX<double> freeD =
+                    TinyAD::newton_direction(freeG, freeH, m_solver);
+                d = Eigen::VectorX<double>::Zero(g.size());
+                for (int k = 0; k < g.size(); ++k) {
+                    if (m_dofToFreeDof[k] >= 0) {
+                        d[k] = freeD[m_dofToFreeDof[k]];
+                    }
+                }
+            }
+            m_x = TinyAD::line_search(
+                m_x, d, f, g, [this](const Eigen::VectorX<PassiveT>& x) {
+                    return eval(x);
+                });
+
+            float convergenceRate = TinyAD::newton_decrement(d, g);
+            ++numIterations;
+            if (convergenceRate < 1e-4) {
+                break;
+            }
+        }
+        std::cout << "  Converged in " << numIterations << " iterations"
+                  << std::endl;
+
+        // Format not weird
+        Eigen::Matrix<PassiveT, Eigen::Dynamic, 2> UV(V.rows(), 2);
+        for (int i = 0; i < V.rows(); ++i)
+            UV.row(i) = m_x.template segment<2>(2 * i);
+
+        return UV;
+    }
+
+   private:
+    /**
+     * Define the local coordinates for a triangle using the first edge and
+     * the normal to make coords.
+     */
+    static Eigen::Matrix<double, 2, 3> flattenTriangle(
+        const Eigen::Vector3d& a_r,
+        const Eigen::Vector3d& b_r,
+        const Eigen::Vector3d& c_r)
+    {
         Eigen::Vector3d             e1     = b_r - a_r;
         Eigen::Vector3d             e2     = c_r - a_r;
         Eigen::Vector3d             normal = e1.cross(e2).normalized();
@@ -34,64 +163,283 @@ Eigen::Matrix<PassiveT, Eigen::Dynamic, 2> param(
         tri2D.col(0) = Eigen::Vector2d(0, 0);
         tri2D.col(1) = Eigen::Vector2d(e1.norm(), 0);
         tri2D.col(2) = Eigen::Vector2d(e2.dot(x_axis), e2.dot(y_axis));
-        flattened_ref_triangles.push_back(tri2D);
+        return tri2D;
     }
 
-    // This is the function which we will optimize, it hopefully returns the
-    // energies for all the faces as a lambda function?
-    auto func = TinyAD::scalar_function<2, PassiveT>(TinyAD::range(V.rows()),
-                                                     TinyAD::EvalSettings{});
-    func.template add_elements<3>(
-        TinyAD::range(F.rows()),
-        [&](auto& element) -> TINYAD_SCALAR_TYPE(element) {
-            using T = TINYAD_SCALAR_TYPE(element);
-            Eigen::Index fid =
-                element.handle;  // Get reference triangle (in 2D) from
-                                 // precomputed flattened geometry
-            const Eigen::Matrix<double, 2, 3>& ref_tri =
-                flattened_ref_triangles[fid];  // Build reference matrix Mr from
-                                               // edges of the flattened
-                                               // triangle
-            Eigen::Matrix<T, 2, 2> Mr;
-            Mr.col(0) = ref_tri.col(1) - ref_tri.col(0);
-            Mr.col(1) = ref_tri.col(2) -
-                        ref_tri.col(0);  // Get embedded triangle from current
-                                         // optimization variables
-            Eigen::Vector<T, 2>    a = element.variables(F(fid, 0));
-            Eigen::Vector<T, 2>    b = element.variables(F(fid, 1));
-            Eigen::Vector<T, 2>    c = element.variables(F(fid, 2));
-            Eigen::Matrix<T, 2, 2> M = TinyAD::col_mat(b - a, c - a);
-            if (M.determinant() <= 0.0) {
-                return INFINITY;
+    /**
+     * Extracts the rows and columns of the free degrees of freedom.
+     */
+    void restrictToFreeDofs(const Eigen::VectorX<PassiveT>&      g,
+                            const Eigen::SparseMatrix<PassiveT>& H,
+                            int                                  numFreeDofs,
+                            Eigen::VectorX<PassiveT>&            freeG,
+                            Eigen::SparseMatrix<PassiveT>&       freeH) const
+    {
+        freeG.resize(numFreeDofs);
+        for (int k = 0; k < g.size(); ++k) {
+            if (m_dofToFreeDof[k] >= 0) {
+                freeG[m_dofToFreeDof[k]] = g[k];
             }
-            return ((M * Mr.inverse()).squaredNorm() +
-                    (Mr * M.inverse()).squaredNorm()) /
-                   (PassiveT)F.rows();
-        });
-    Eigen::VectorX<PassiveT> x = func.x_from_data(
-        [&](Eigen::Index v_idx) { return previousParam.row(v_idx); });
-    TinyAD::LinearSolver<PassiveT> solver;
-
-    // Optimization step based off the defined function
-    std::vector<double> convergenceHistory;
-    for (int i = 0; i < numMaxIterations; ++i) {
-        auto [f, g, H_proj]      = func.eval_with_hessian_proj(x);
-        Eigen::VectorX<double> d = TinyAD::newton_direction(g, H_proj, solver);
-        x                        = TinyAD::line_search(x, d, f, g, func);
-
-        float convergenceRate = TinyAD::newton_decrement(d, g);
-        convergenceHistory.push_back(convergenceRate);
-        if (convergenceRate < 1e-4) {
-            break;
         }
+
+        std::vector<Eigen::Triplet<PassiveT>> triplets;
+        triplets.reserve(H.nonZeros());
+        for (int k = 0; k < H.outerSize(); ++k) {
+            for (typename Eigen::SparseMatrix<PassiveT>::InnerIterator it(H, k);
+                 it;
+                 ++it) {
+                const int row = m_dofToFreeDof[it.row()];
+                const int col = m_dofToFreeDof[it.col()];
+                if (row >= 0 && col >= 0) {
+                    triplets.emplace_back(row, col, it.value());
+                }
+            }
+        }
+        freeH.resize(numFreeDofs, numFreeDofs);
+        freeH.setFromTriplets(triplets.begin(), triplets.end());
     }
-    std::cout << "  Converged in " << convergenceHistory.size() << " iterations"
-              << std::endl;
 
-    // Format not weird
-    Eigen::Matrix<PassiveT, Eigen::Dynamic, 2> UV(V.rows(), 2);
-    for (int i = 0; i < V.rows(); ++i)
-        UV.row(i) = x.template segment<2>(2 * i);
+    void flattenFace(int i)
+    {
+        m_flattenedRefTriangles[i] =
+            flattenTriangle(m_referenceVertices.row(m_faces(i, 0)).transpose(),
+                            m_referenceVertices.row(m_faces(i, 1)).transpose(),
+                            m_referenceVertices.row(m_faces(i, 2)).transpose());
+    }
+
+    void setup(const Eigen::MatrixXd& V, const Eigen::MatrixXi& F)
+    {
+        clear();
+        m_faces             = F;
+        m_referenceVertices = V;
+        m_flattenedRefTriangles.resize(F.rows());
+        for (int i = 0; i < F.rows(); ++i) {
+            flattenFace(i);
+        }
+        m_hasMoved.assign(V.rows(), false);
+
+        // Every face couples the 6 variables of its corners. The pattern is
+        // assembled once with zeros, then every element entry remembers the
+        // position of its value in the compressed matrix.
+        const int                             numFaces = F.rows();
+        std::vector<Eigen::Triplet<PassiveT>> triplets;
+        triplets.reserve(36 * numFaces);
+        for (int i = 0; i < numFaces; ++i) {
+            for (int r = 0; r < 6; ++r) {
+                for (int c = 0; c < 6; ++c) {
+                    triplets.emplace_back(getDof(i, r), getDof(i, c), 0);
+                }
+            }
+        }
+        m_hessian.resize(2 * V.rows(), 2 * V.rows());
+        m_hessian.setFromTriplets(triplets.begin(), triplets.end());
+        m_hessian.makeCompressed();
+
+        m_hessianSlots.resize(36 * numFaces);
+        for (int i = 0; i < numFaces; ++i) {
+            for (int c = 0; c < 6; ++c) {
+                const int* begin =
+                    m_hessian.innerIndexPtr() +
+                    m_hessian.outerIndexPtr()[getDof(i, c)];
+                const int* end = m_hessian.innerIndexPtr() +
+                                 m_hessian.outerIndexPtr()[getDof(i, c) + 1];
+                for (int r = 0; r < 6; ++r) {
+                    m_hessianSlots[36 * i + 6 * c + r] =
+                        std::lower_bound(begin, end, getDof(i, r)) -
+                        m_hessian.innerIndexPtr();
+                }
+            }
+        }
+
+        m_faceEnergies.resize(numFaces);
+        m_faceGradients.resize(numFaces);
+        m_faceHessians.resize(numFaces);
+    }
+
+    int getDof(int faceIdx, int localDof) const
+    {
+        return 2 * m_faces(faceIdx, localDof / 2) + localDof % 2;
+    }
 
-    return UV;
-}
\ No newline at end of file
+    /**
+     * Symmetric Dirichlet energy of one face, infinite if it is flipped.
+     */
+    template <typename T>
+    T faceEnergy(int                        fid,
+                 const Eigen::Vector<T, 2>& a,
+                 const Eigen::Vector<T, 2>& b,
+                 const Eigen::Vector<T, 2>& c) const
+    {
+        // Get reference triangle (in 2D) from precomputed flattened geometry
+        // and build reference matrix Mr from its edges
+        const Eigen::Matrix<double, 2, 3>& ref_tri =
+            m_flattenedRefTriangles[fid];
+        Eigen::Matrix<T, 2, 2> Mr;
+        Mr.col(0) = ref_tri.col(1) - ref_tri.col(0);
+        Mr.col(1) = ref_tri.col(2) - ref_tri.col(0);
+
+        Eigen::Matrix<T, 2, 2> M = TinyAD::col_mat(b - a, c - a);
+        if (M.determinant() <= 0.0) {
+            return INFINITY;
+        }
+        return ((M * Mr.inverse()).squaredNorm() +
+                (Mr * M.inverse()).squaredNorm()) /
+               (PassiveT)m_faces.rows();
+    }
+
+    /**
+     * Clamps the eigenvalues of an element Hessian from below, like TinyAD
+     * does for eval_with_hessian_proj().
+     */
+    static void projectPositiveDefinite(Eigen::Matrix<PassiveT, 6, 6>& H)
+    {
+        const PassiveT eigenvalueEps = 1e-9;
+        Eigen::SelfAdjointEigenSolver<Eigen::Matrix<PassiveT, 6, 6>> eigen(H);
+        if (eigen.eigenvalues().minCoeff() >= eigenvalueEps) {
+            return;
+        }
+        Eigen::Vector<PassiveT, 6> eigenvalues =
+            eigen.eigenvalues().cwiseMax(eigenvalueEps);
+        H = eigen.eigenvectors() * eigenvalues.asDiagonal() *
+            eigen.eigenvectors().transpose();
+    }
+
+    /**
+     * @return The energy at x.
+     */
+    PassiveT eval(const Eigen::VectorX<PassiveT>& x)
+    {
+        const int numFaces   = m_faces.rows();
+        const int numThreads = m_numThreads;
+#pragma omp parallel for schedule(static) if (numThreads > 1) \
+    num_threads(numThreads)
+        for (int i = 0; i < numFaces; ++i) {
+            m_faceEnergies[i] =
+                faceEnergy<PassiveT>(i,
+                                     x.template segment<2>(2 * m_faces(i, 0)),
+                                     x.template segment<2>(2 * m_faces(i, 1)),
+                                     x.template segment<2>(2 * m_faces(i, 2)));
+        }
+
+        PassiveT f = 0;
+        for (int i = 0; i < numFaces; ++i) {
+            f += m_faceEnergies[i];
+        }
+        return f;
+    }
+
+    /**
+     * Evaluates the energy, its gradient into m_gradient and its projected
+     * Hessian into the values of m_hessian.
+     *
+     * @return The energy at x.
+     */
+    PassiveT evalWithHessianProj(const Eigen::VectorX<PassiveT>& x)
+    {
+        using T = TinyAD::Double<6, PassiveT>;
+
+        const int numFaces   = m_faces.rows();
+        const int numThreads = m_numThreads;
+#pragma omp parallel for schedule(static) if (numThreads > 1) \
+    num_threads(numThreads)
+        for (int i = 0; i < numFaces; ++i) {
+            Eigen::Vector<PassiveT, 6> corners;
+            for (int k = 0; k < 6; ++k) {
+                corners[k] = x[getDof(i, k)];
+            }
+            Eigen::Vector<T, 6> vars = T::make_active(corners);
+            T energy = faceEnergy<T>(i,
+                                     Eigen::Vector<T, 2>(vars[0], vars[1]),
+                                     Eigen::Vector<T, 2>(vars[2], vars[3]),
+                                     Eigen::Vector<T, 2>(vars[4], vars[5]));
+
+            m_faceEnergies[i] = energy.val;
+            if (std::isfinite(energy.val)) {
+                m_faceGradients[i] = energy.grad;
+                m_faceHessians[i]  = energy.Hess;
+                projectPositiveDefinite(m_faceHessians[i]);
+            } else {
+                m_faceGradients[i].setZero();
+                m_faceHessians[i].setZero();
+            }
+        }
+
+        // Serial assembly in face order keeps the sums independent of the
+        // thread count
+        PassiveT f = 0;
+        m_gradient = Eigen::VectorX<PassiveT>::Zero(x.size());
+        PassiveT* hessianValues = m_hessian.valuePtr();
+        std::fill(hessianValues, hessianValues + m_hessian.nonZeros(), 0);
+        for (int i = 0; i < numFaces; ++i) {
+            f += m_faceEnergies[i];
+            for (int k = 0; k < 6; ++k) {
+                m_gradient[getDof(i, k)] += m_faceGradients[i][k];
+            }
+            for (int k = 0; k < 36; ++k) {
+                hessianValues[m_hessianSlots[36 * i + k]] +=
+                    m_faceHessians[i](k % 6, k / 6);
+            }
+        }
+        return f;
+    }
+
+    /**
+     * Re-flattens the faces touching a vertex that moved since the last call.
+     */
+    void updateReferenceTriangles(const Eigen::MatrixXd& V)
+    {
+        bool anyMoved = false;
+        for (int i = 0; i < V.rows(); ++i) {
+            m_hasMoved[i] = V.row(i) != m_referenceVertices.row(i);
+            anyMoved |= m_hasMoved[i];
+        }
+        if (!anyMoved) {
+            return;
+        }
+
+        m_referenceVertices = V;
+        for (int i = 0; i < m_faces.rows(); ++i) {
+            if (m_hasMoved[m_faces(i, 0)] || m_hasMoved[m_faces(i, 1)] ||
+                m_hasMoved[m_faces(i, 2)]) {
+                flattenFace(i);
+            }
+        }
+    }
+
+    // Geometry the reference triangles were flattened from
+    Eigen::MatrixXi                          m_faces;
+    Eigen::MatrixXd                          m_referenceVertices;
+    std::vector<Eigen::Matrix<double, 2, 3>> m_flattenedRefTriangles;
+    std::vector<bool>                        m_hasMoved;
+
+    // Index of every variable among the free ones, -1 if fixed; empty when
+    // all vertices are free
+    std::vector<int> m_dofToFreeDof;
+
+    // Assembled derivatives, the Hessian keeps its pattern between calls and
+    // m_hessianSlots holds the value index of every (column-major) entry of
+    // every element Hessian
+    Eigen::VectorX<PassiveT>      m_gradient;
+    Eigen::SparseMatrix<PassiveT> m_hessian;
+    std::vector<int>              m_hessianSlots;
+
+    // Per-face results, written in parallel and summed in face order
+    std::vector<PassiveT>                      m_faceEnergies;
+    std::vector<Eigen::Vector<PassiveT, 6>>    m_faceGradients;
+    std::vector<Eigen::Matrix<PassiveT, 6, 6>> m_faceHessians;
+
+    TinyAD::LinearSolver<PassiveT> m_solver;
+    Eigen::VectorX<PassiveT>       m_x;
+    int                            m_numThreads = 1;
+};
+
+template <typename PassiveT>
+Eigen::Matrix<PassiveT, Eigen::Dynamic, 2> param(
+    const Eigen::MatrixXd& V,
+    const Eigen::MatrixXi& F,
+    Eigen::MatrixXd&       previousParam,
+    const int              numMaxIterations = 30)
+{
+    Parametrizer<PassiveT> parametrizer;
+    return parametrizer.solve(V, F, previousParam, numMaxIterations);
+}
@@ -0,0 +1,54 @@
+#include "selectionSet.h"
+
+#include <algorithm>
+
+namespace locremesh {
+
+SelectionSet::SelectionSet(const std::vector<bool>& bitMask)
+    : m_mask(bitMask.size(), 0)
+{
+    for (int i = 0; i < bitMask.size(); ++i) {
+        if (bitMask[i]) {
+            m_mask[i] = 1;
+            m_idxs.push_back(i);
+        }
+    }
+}
+
+void SelectionSet::resize(int maskSize)
+{
+    if (maskSize == m_mask.size()) {
+        clear();
+        return;
+    }
+    m_mask.assign(maskSize, 0);
+    m_idxs.clear();
+    m_isCompact = true;
+}
+
+void SelectionSet::clear()
+{
+    for (int idx : m_idxs) {
+        m_mask[idx] = 0;
+    }
+    m_idxs.clear();
+    m_isCompact = true;
+}
+
+const std::vector<int>& SelectionSet::getIndices() const
+{
+    if (!m_isCompact) {
+        // Erased entries are still listed, and listed again if they were
+        // inserted back since
+        std::sort(m_idxs.begin(), m_idxs.end());
+        m_idxs.erase(std::unique(m_idxs.begin(), m_idxs.end()), m_idxs.end());
+        m_idxs.erase(std::remove_if(m_idxs.begin(),
+                                    m_idxs.end(),
+                                    [&](int idx) { return !m_mask[idx]; }),
+                     m_idxs.end());
+        m_isCompact = true;
+    }
+    return m_idxs;
+}
+
+}  // namespace locremesh
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+
+namespace locremesh {
+
+/**
+ * A set of vertex indices kept both as a dense mask, for constant time
+ * membership tests, and as a list of the selected indices, so that walking
+ * or clearing the selection costs time proportional to its size instead of
+ * the size of the mesh.
+ *
+ * The list is brought up to date lazily, the first time it is read after an
+ * insertion out of order or a removal.
+ */
+class SelectionSet
+{
+   public:
+    SelectionSet() = default;
+    explicit SelectionSet(int maskSize) : m_mask(maskSize, 0) {}
+    explicit SelectionSet(const std::vector<bool>& bitMask);
+
+    /**
+     * Empties the selection and resizes the mask to the given number of
+     * vertices.
+     */
+    void resize(int maskSize);
+    void clear();
+
+    void insert(int idx)
+    {
+        if (!m_mask[idx]) {
+            m_mask[idx] = 1;
+            m_isCompact =
+                m_isCompact && (m_idxs.empty() || m_idxs.back() < idx);
+            m_idxs.push_back(idx);
+        }
+    }
+
+    void erase(int idx)
+    {
+        if (m_mask[idx]) {
+            m_mask[idx] = 0;
+            m_isCompact = false;
+        }
+    }
+
+    bool contains(int idx) const
+    {
+        return m_mask[idx];
+    }
+
+    // Get methods -------------------------------------------------------------
+    int size() const
+    {
+        return getIndices().size();
+    }
+    bool empty() const
+    {
+        return getIndices().empty();
+    }
+    int getMaskSize() const
+    {
+        return m_mask.size();
+    }
+    const std::vector<char>& getMask() const
+    {
+        return m_mask;
+    }
+    const std::vector<int>& getIndices() const;
+
+   private:
+    std::vector<char>        m_mask;
+    mutable std::vector<int> m_idxs;
+    // Whether m_idxs is sorted and holds no erased or repeated entries
+    mutable bool             m_isCompact = true;
+};
+
+}  // namespace locremesh
@@ -0,0 +1,66 @@
+#include "simulation.h"
+
+#include <limits>
+
+namespace locremesh {
+
+void Simulation::step(double simulatedTime)
+{
+    StageTimer::Scope stepScope(m_stageTimer, "step");
+
+    if (m_autoRemeshing) {
+        // Run remeshing for selected vertices in the previous update, unless
+        // they are the same as when it last ran
+        if (m_vertexSelector.hasPendingSelection()) {
+            StageTimer::Scope scope(m_stageTimer, "remesh");
+            m_botschRemesher.remesh();
+            m_vertexSelector.clearPendingSelection();
+        }
+        StageTimer::Scope scope(m_stageTimer, "parametrization");
+        if (m_localParametrization) {
+            m_mesh.calculateUVParametrizationLocally(
+                m_numLocalParametrizationRings);
+        } else {
+            m_mesh.calculateUVParametrization(false);
+        }
+    }
+
+    // While the mass-spring simulation isn't ready, we move the mesh
+    // by going through the vertices and updating their z position
+    // according to a sine function
+    {
+        StageTimer::Scope scope(m_stageTimer, "deformation");
+        Eigen::MatrixXd   newVertices = m_mesh.getVertices();
+        for (int i = 0; i < newVertices.rows(); ++i) {
+            newVertices(i, 2) =
+                m_amplitude * std::sin(newVertices(i, 0) * m_spatialFrequency +
+                                       simulatedTime / 1.5);
+        }
+        m_mesh.updateVertexPositions(newVertices);
+    }
+
+    {
+        StageTimer::Scope scope(m_stageTimer, "quality");
+        m_mesh.updateMeshQuality();
+    }
+
+    if (m_autoRemeshing) {
+        {
+            StageTimer::Scope scope(m_stageTimer, "selection");
+            m_vertexSelector.selectVerticesBasedOnQuality();
+        }
+        StageTimer::Scope scope(m_stageTimer, "dilation");
+        m_vertexSelector.dilate(m_numOneRingDilationIterations,
+                                m_dilationRadius > 0
+                                    ? m_dilationRadius
+                                    : std::numeric_limits<double>::infinity(),
+                                m_dilationMetric);
+    }
+
+    if (m_autoParametrization && !m_autoRemeshing) {
+        StageTimer::Scope scope(m_stageTimer, "parametrization");
+        m_mesh.calculateUVParametrization(true);
+    }
+}
+
+}  // namespace locremesh
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "botschRemesher.h"
+#include "mesh.h"
+#include "stageTimer.h"
+#include "vertexSelector.h"
+
+namespace locremesh {
+
+/**
+ * One fixed timestep of the deform, select, remesh and parametrize loop.
+ *
+ * It is shared by the interactive viewer and the headless driver, so that
+ * both run exactly the same pipeline. It never touches polyscope.
+ */
+class Simulation
+{
+   public:
+    Simulation(Mesh&           mesh,
+               VertexSelector& vertexSelector,
+               BotschRemesher& botschRemesher)
+        : m_mesh(mesh),
+          m_vertexSelector(vertexSelector),
+          m_botschRemesher(botschRemesher)
+    {
+    }
+
+    void step(double simulatedTime);
+
+    void setStageTimer(StageTimer* stageTimer)
+    {
+        m_stageTimer = stageTimer;
+    }
+
+   private:
+    Mesh&           m_mesh;
+    VertexSelector& m_vertexSelector;
+    BotschRemesher& m_botschRemesher;
+    StageTimer*     m_stageTimer = nullptr;
+
+   public:
+    float m_spatialFrequency             = 15.f;
+    float m_amplitude                    = 0.1f;
+    int   m_numOneRingDilationIterations = 5;
+    bool  m_autoRemeshing                = false;
+    bool  m_autoParametrization          = false;
+
+    // Dilated vertices stay within this distance of the selection, no limit
+    // when zero
+    float          m_dilationRadius = 0.f;
+    DilationMetric m_dilationMetric = DilationMetric::Geodesic;
+
+    // After a remesh, only re-optimize the UVs of the remeshed patches plus
+    // this many rings around them
+    bool m_localParametrization         = true;
+    int  m_numLocalParametrizationRings = 1;
+};
+
+}  // namespace locremesh
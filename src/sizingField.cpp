@@ -0,0 +1,182 @@
+#include "sizingField.h"
+#include "igl/per_vertex_normals.h"
+#include "indicatorFunctions.h"
+
+#include <Eigen/Eigenvalues>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+
+namespace locremesh {
+
+Eigen::VectorXd SizingField::compute(Mesh& mesh, double targetEdgeLength) const
+{
+    const int numVertices = mesh.getVertexCount();
+
+    Eigen::VectorXd target    = computeCurvatureTarget(mesh, targetEdgeLength);
+    Eigen::VectorXd strain    = computeStrain(mesh);
+    Eigen::VectorXd quality   = computeQuality(mesh);
+    const double    minTarget = m_minScale * targetEdgeLength;
+    const double    maxTarget = m_maxScale * targetEdgeLength;
+    for (int i = 0; i < numVertices; ++i) {
+        const double shrink = (1 + m_strainWeight * strain[i]) *
+                              (1 + m_qualityWeight * (1 - quality[i]));
+        target[i] = std::min(target[i], targetEdgeLength / shrink);
+        target[i] = std::clamp(target[i], minTarget, maxTarget);
+    }
+
+    applyGradation(mesh, target);
+    return target;
+}
+
+/**
+ * Longest edges that keep the chordal error below the tolerance. An edge of
+ * length h on a circle of radius r deviates from it by about h^2 / (8 r), and
+ * the curvature at a vertex is estimated from how fast the normal turns along
+ * its edges.
+ */
+Eigen::VectorXd SizingField::computeCurvatureTarget(
+    Mesh&  mesh,
+    double targetEdgeLength) const
+{
+    const Eigen::MatrixXd&  vertices     = mesh.getVertices();
+    const MeshConnectivity& connectivity = mesh.getConnectivity();
+    const int               numVertices  = mesh.getVertexCount();
+    const double tolerance = m_curvatureTolerance * targetEdgeLength;
+
+    Eigen::MatrixXd normals;
+    igl::per_vertex_normals(vertices, mesh.getFaces(), normals);
+
+    Eigen::VectorXd target =
+        Eigen::VectorXd::Constant(numVertices, m_maxScale * targetEdgeLength);
+    for (int i = 0; i < numVertices; ++i) {
+        double curvature = 0;
+        for (int j : connectivity.getVertexNeighbors(i)) {
+            const double length = (vertices.row(j) - vertices.row(i)).norm();
+            if (length > 0) {
+                curvature = std::max(
+                    curvature,
+                    (normals.row(j) - normals.row(i)).norm() / length);
+            }
+        }
+        if (curvature > 0) {
+            target[i] = std::min(target[i],
+                                 std::sqrt(8 * tolerance / curvature));
+        }
+    }
+    return target;
+}
+
+/**
+ * How far the triangles are stretched or compressed with respect to their
+ * rest shape, the largest deviation of the singular values of the map from
+ * the rest triangle to the current one from one, maximized over the faces
+ * around every vertex. Zero when the mesh has no rest shape.
+ */
+Eigen::VectorXd SizingField::computeStrain(const Mesh& mesh) const
+{
+    const Eigen::MatrixXd& vertices     = mesh.getVertices();
+    const Eigen::MatrixXd& restVertices = mesh.getRestVertices();
+    const Eigen::MatrixXi& faces        = mesh.getFaces();
+
+    Eigen::VectorXd strain = Eigen::VectorXd::Zero(mesh.getVertexCount());
+    if (restVertices.rows() != vertices.rows()) {
+        return strain;
+    }
+
+    for (int f = 0; f < faces.rows(); ++f) {
+        Eigen::Matrix<double, 3, 2> edges, restEdges;
+        for (int k = 0; k < 2; ++k) {
+            edges.col(k) = (vertices.row(faces(f, k + 1)) -
+                            vertices.row(faces(f, 0)))
+                               .transpose();
+            restEdges.col(k) = (restVertices.row(faces(f, k + 1)) -
+                                restVertices.row(faces(f, 0)))
+                                   .transpose();
+        }
+
+        // The rest triangle in an orthonormal frame of its own plane
+        const Eigen::Vector3d e0 = restEdges.col(0).normalized();
+        const Eigen::Vector3d e1 =
+            (restEdges.col(1) - restEdges.col(1).dot(e0) * e0).normalized();
+        Eigen::Matrix2d restFrame;
+        restFrame << restEdges.col(0).dot(e0), restEdges.col(1).dot(e0),
+            0, restEdges.col(1).dot(e1);
+        if (!restFrame.allFinite() ||
+            std::abs(restFrame.determinant()) < 1e-14) {
+            continue;
+        }
+
+        const Eigen::Matrix<double, 3, 2> jacobian =
+            edges * restFrame.inverse();
+        Eigen::SelfAdjointEigenSolver<Eigen::Matrix2d> eigenSolver(
+            jacobian.transpose() * jacobian, Eigen::EigenvaluesOnly);
+        const Eigen::Vector2d singularValues =
+            eigenSolver.eigenvalues().cwiseMax(0).cwiseSqrt();
+
+        const double deviation = (singularValues.array() - 1).abs().maxCoeff();
+        for (int k = 0; k < 3; ++k) {
+            strain[faces(f, k)] = std::max(strain[faces(f, k)], deviation);
+        }
+    }
+    return strain;
+}
+
+/**
+ * Quality of the worst face around every vertex, one for isolated vertices.
+ */
+Eigen::VectorXd SizingField::computeQuality(const Mesh& mesh) const
+{
+    const Eigen::MatrixXi& faces = mesh.getFaces();
+
+    Eigen::VectorXd faceQuality = mesh.getQuality();
+    if (faceQuality.size() != faces.rows()) {
+        faceQuality = indFuncTriangleQuality(mesh.getVertices(), faces);
+    }
+
+    Eigen::VectorXd quality = Eigen::VectorXd::Ones(mesh.getVertexCount());
+    for (int f = 0; f < faces.rows(); ++f) {
+        for (int k = 0; k < 3; ++k) {
+            quality[faces(f, k)] =
+                std::min(quality[faces(f, k)], faceQuality[f]);
+        }
+    }
+    return quality;
+}
+
+/**
+ * Lowers the targets until target[j] <= target[i] + m_gradation * |x_i - x_j|
+ * holds along every edge. Vertices are settled from the smallest target up,
+ * as in Dijkstra's algorithm, so each one is final once it is popped.
+ */
+void SizingField::applyGradation(Mesh& mesh, Eigen::VectorXd& target) const
+{
+    const Eigen::MatrixXd&  vertices     = mesh.getVertices();
+    const MeshConnectivity& connectivity = mesh.getConnectivity();
+
+    using Entry = std::pair<double, int>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+    for (int i = 0; i < target.size(); ++i) {
+        queue.push({target[i], i});
+    }
+
+    while (!queue.empty()) {
+        const auto [value, i] = queue.top();
+        queue.pop();
+        if (value > target[i]) {
+            continue;
+        }
+        for (int j : connectivity.getVertexNeighbors(i)) {
+            const double bound =
+                target[i] +
+                m_gradation * (vertices.row(j) - vertices.row(i)).norm();
+            if (target[j] > bound) {
+                target[j] = bound;
+                queue.push({bound, j});
+            }
+        }
+    }
+}
+
+}  // namespace locremesh
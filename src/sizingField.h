@@ -0,0 +1,55 @@
+#pragma once
+
+#include <Eigen/Core>
+
+#include "mesh.h"
+
+namespace locremesh {
+
+/**
+ * Per-vertex target edge lengths for remesh_botsch.
+ *
+ * Starting from the uniform target edge length, the field shrinks the target
+ * where the surface is curved, where the triangles are strained with respect
+ * to the rest shape of the mesh and where they are of poor quality, and grows
+ * it up to a maximum elsewhere. The result is limited by a
+ * gradation bound, so that neighbouring targets never differ by more than a
+ * fraction of the distance between them and the remesher does not have to
+ * produce sudden jumps in resolution.
+ */
+class SizingField
+{
+   public:
+    /**
+     * @param targetEdgeLength The edge length of a flat, unstrained region of
+     * good triangles. The field stays within m_minScale and m_maxScale times
+     * this length.
+     * @return One target edge length per vertex of the mesh.
+     */
+    Eigen::VectorXd compute(Mesh& mesh, double targetEdgeLength) const;
+
+    // Defined in ui/, which only the viewer is built with
+    void polyscopeUISection();
+
+   private:
+    Eigen::VectorXd computeCurvatureTarget(Mesh&  mesh,
+                                           double targetEdgeLength) const;
+    Eigen::VectorXd computeStrain(const Mesh& mesh) const;
+    Eigen::VectorXd computeQuality(const Mesh& mesh) const;
+    void            applyGradation(Mesh& mesh, Eigen::VectorXd& target) const;
+
+   public:
+    // Largest distance allowed between the surface and an edge, relative to
+    // the target edge length. Smaller values refine curved regions more.
+    float m_curvatureTolerance = 0.05f;
+    // How strongly strain and poor quality shrink the target
+    float m_strainWeight  = 1.f;
+    float m_qualityWeight = 1.f;
+    // Bounds of the field relative to the target edge length
+    float m_minScale = 0.25f;
+    float m_maxScale = 4.f;
+    // Largest change of the target per unit of distance along an edge
+    float m_gradation = 0.3f;
+};
+
+}  // namespace locremesh
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace locremesh {
+
+/**
+ * Accumulates wall-clock timings of named pipeline stages.
+ *
+ * Every measurement of a stage is kept, so that per-step timings can be
+ * written out next to the summary statistics.
+ */
+class StageTimer
+{
+   public:
+    struct Stage
+    {
+        std::string         name;
+        std::vector<double> samplesMs;
+
+        double getTotalMs() const
+        {
+            double total = 0;
+            for (double ms : samplesMs) {
+                total += ms;
+            }
+            return total;
+        }
+        double getMaxMs() const
+        {
+            return samplesMs.empty()
+                       ? 0
+                       : *std::max_element(samplesMs.begin(), samplesMs.end());
+        }
+        double getMinMs() const
+        {
+            return samplesMs.empty()
+                       ? 0
+                       : *std::min_element(samplesMs.begin(), samplesMs.end());
+        }
+    };
+
+    /**
+     * Measures the lifetime of the scope it is created in.
+     */
+    class Scope
+    {
+       public:
+        Scope(StageTimer* timer, std::string stage)
+            : m_timer(timer),
+              m_stage(std::move(stage)),
+              m_start(std::chrono::steady_clock::now())
+        {
+        }
+        Scope(const Scope&)            = delete;
+        Scope& operator=(const Scope&) = delete;
+        ~Scope()
+        {
+            if (m_timer) {
+                std::chrono::duration<double, std::milli> elapsed =
+                    std::chrono::steady_clock::now() - m_start;
+                m_timer->record(m_stage, elapsed.count());
+            }
+        }
+
+       private:
+        StageTimer*                           m_timer;
+        std::string                           m_stage;
+        std::chrono::steady_clock::time_point m_start;
+    };
+
+    void record(const std::string& stage, double ms)
+    {
+        getStage(stage).samplesMs.push_back(ms);
+    }
+
+    const std::vector<Stage>& getStages() const
+    {
+        return m_stages;
+    }
+
+    void clear()
+    {
+        m_stages.clear();
+    }
+
+    /**
+     * Writes every stage as a JSON object holding its summary statistics and
+     * the individual samples, in the order the stages were first recorded.
+     */
+    void writeJSON(std::ostream& os, const std::string& indent = "") const
+    {
+        os << "{\n";
+        for (int i = 0; i < m_stages.size(); ++i) {
+            const Stage& stage = m_stages[i];
+            os << indent << "  \"" << stage.name << "\": {"
+               << "\"count\": " << stage.samplesMs.size()
+               << ", \"total_ms\": " << stage.getTotalMs()
+               << ", \"mean_ms\": "
+               << (stage.samplesMs.empty()
+                       ? 0
+                       : stage.getTotalMs() / stage.samplesMs.size())
+               << ", \"min_ms\": " << stage.getMinMs()
+               << ", \"max_ms\": " << stage.getMaxMs() << ", \"samples_ms\": [";
+            for (int j = 0; j < stage.samplesMs.size(); ++j) {
+                os << (j ? ", " : "") << stage.samplesMs[j];
+            }
+            os << "]}" << (i + 1 < m_stages.size() ? "," : "") << "\n";
+        }
+        os << indent << "}";
+    }
+
+   private:
+    Stage& getStage(const std::string& name)
+    {
+        for (Stage& stage : m_stages) {
+            if (stage.name == name) {
+                return stage;
+            }
+        }
+        m_stages.push_back({name, {}});
+        return m_stages.back();
+    }
+
+    std::vector<Stage> m_stages;
+};
+
+}  // namespace locremesh
@@ -0,0 +1,203 @@
+#include "submesh.h"
+
+#include <algorithm>
+
+namespace locremesh {
+
+namespace {
+
+int findLocalIdx(const std::vector<int>& sortedIdxs, int idx)
+{
+    auto it = std::lower_bound(sortedIdxs.begin(), sortedIdxs.end(), idx);
+    if (it == sortedIdxs.end() || *it != idx) {
+        return -1;
+    }
+    return it - sortedIdxs.begin();
+}
+
+/**
+ * Same as extractSubmesh(), for the subset activeIdxs of the active vertices.
+ * It must be sorted and closed under adjacency within active, i.e. a union of
+ * connected components, so that every patch face has all its active corners
+ * in activeIdxs.
+ */
+Submesh extractSubmesh(const Eigen::MatrixXd&  vertices,
+                       const Eigen::MatrixXi&  faces,
+                       const MeshConnectivity& connectivity,
+                       const SelectionSet&     active,
+                       const std::vector<int>& activeIdxs)
+{
+    Submesh patch;
+
+    // Every face touching an active vertex can be modified by the remesher
+    for (int v : activeIdxs) {
+        for (int f : connectivity.getVertexFaces(v)) {
+            patch.parentFaceIdxs.push_back(f);
+        }
+    }
+    std::sort(patch.parentFaceIdxs.begin(), patch.parentFaceIdxs.end());
+    patch.parentFaceIdxs.erase(
+        std::unique(patch.parentFaceIdxs.begin(), patch.parentFaceIdxs.end()),
+        patch.parentFaceIdxs.end());
+
+    // The other corners of those faces make up the frozen ring
+    std::vector<int> frozenIdxs;
+    for (int f : patch.parentFaceIdxs) {
+        for (int j = 0; j < 3; ++j) {
+            if (!active.contains(faces(f, j))) {
+                frozenIdxs.push_back(faces(f, j));
+            }
+        }
+    }
+    std::sort(frozenIdxs.begin(), frozenIdxs.end());
+    frozenIdxs.erase(std::unique(frozenIdxs.begin(), frozenIdxs.end()),
+                     frozenIdxs.end());
+
+    patch.numFrozenVertices = frozenIdxs.size();
+    patch.parentVertexIdxs  = frozenIdxs;
+    patch.parentVertexIdxs.insert(
+        patch.parentVertexIdxs.end(), activeIdxs.begin(), activeIdxs.end());
+
+    patch.vertices.resize(patch.parentVertexIdxs.size(), 3);
+    for (int i = 0; i < patch.parentVertexIdxs.size(); ++i) {
+        patch.vertices.row(i) = vertices.row(patch.parentVertexIdxs[i]);
+    }
+
+    patch.faces.resize(patch.parentFaceIdxs.size(), 3);
+    for (int i = 0; i < patch.parentFaceIdxs.size(); ++i) {
+        for (int j = 0; j < 3; ++j) {
+            int v = faces(patch.parentFaceIdxs[i], j);
+            patch.faces(i, j) =
+                active.contains(v)
+                    ? patch.numFrozenVertices + findLocalIdx(activeIdxs, v)
+                    : findLocalIdx(frozenIdxs, v);
+        }
+    }
+
+    patch.feature = Eigen::VectorXi::LinSpaced(
+        patch.numFrozenVertices, 0, patch.numFrozenVertices - 1);
+
+    return patch;
+}
+
+}  // namespace
+
+Submesh extractSubmesh(const Eigen::MatrixXd&  vertices,
+                       const Eigen::MatrixXi&  faces,
+                       const MeshConnectivity& connectivity,
+                       const SelectionSet&     active)
+{
+    return extractSubmesh(
+        vertices, faces, connectivity, active, active.getIndices());
+}
+
+std::vector<Submesh> extractSubmeshes(const Eigen::MatrixXd&  vertices,
+                                      const Eigen::MatrixXi&  faces,
+                                      const MeshConnectivity& connectivity,
+                                      const SelectionSet&     active)
+{
+    std::vector<Submesh> patches;
+    SelectionSet         visited(active.getMaskSize());
+    std::vector<int>     component;
+    for (int seed : active.getIndices()) {
+        if (visited.contains(seed)) {
+            continue;
+        }
+        component.assign(1, seed);
+        visited.insert(seed);
+        for (int i = 0; i < component.size(); ++i) {
+            const int v = component[i];
+            for (int neighborIdx : connectivity.getVertexNeighbors(v)) {
+                if (active.contains(neighborIdx) &&
+                    !visited.contains(neighborIdx)) {
+                    visited.insert(neighborIdx);
+                    component.push_back(neighborIdx);
+                }
+            }
+        }
+        std::sort(component.begin(), component.end());
+        patches.push_back(
+            extractSubmesh(vertices, faces, connectivity, active, component));
+    }
+    return patches;
+}
+
+StitchMap stitchSubmeshes(const Eigen::MatrixXd&      vertices,
+                          const Eigen::MatrixXi&      faces,
+                          const std::vector<Submesh>& patches,
+                          Eigen::MatrixXd&            stitchedVertices,
+                          Eigen::MatrixXi&            stitchedFaces)
+{
+    std::vector<bool> isReplacedVertex(vertices.rows(), false);
+    std::vector<bool> isReplacedFace(faces.rows(), false);
+    int               numNewVertices = 0;
+    int               numNewFaces    = 0;
+    for (const Submesh& patch : patches) {
+        for (int i = patch.numFrozenVertices; i < patch.parentVertexIdxs.size();
+             ++i) {
+            isReplacedVertex[patch.parentVertexIdxs[i]] = true;
+        }
+        for (int f : patch.parentFaceIdxs) {
+            isReplacedFace[f] = true;
+        }
+        numNewVertices += patch.vertices.rows() - patch.numFrozenVertices;
+        numNewFaces += patch.faces.rows();
+    }
+
+    StitchMap        map;
+    std::vector<int> parentToStitched(vertices.rows(), -1);
+    for (int i = 0; i < vertices.rows(); ++i) {
+        if (!isReplacedVertex[i]) {
+            parentToStitched[i] = map.vertexSource.size();
+            map.vertexSource.push_back(i);
+        }
+    }
+    for (int f = 0; f < faces.rows(); ++f) {
+        if (!isReplacedFace[f]) {
+            map.faceSource.push_back(f);
+        }
+    }
+
+    const int numKeptVertices = map.vertexSource.size();
+    const int numKeptFaces    = map.faceSource.size();
+    map.vertexSource.resize(numKeptVertices + numNewVertices, -1);
+    map.faceSource.resize(numKeptFaces + numNewFaces, -1);
+
+    stitchedVertices.resize(numKeptVertices + numNewVertices, 3);
+    stitchedFaces.resize(numKeptFaces + numNewFaces, 3);
+    for (int i = 0; i < numKeptVertices; ++i) {
+        stitchedVertices.row(i) = vertices.row(map.vertexSource[i]);
+    }
+    for (int i = 0; i < numKeptFaces; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            stitchedFaces(i, j) = parentToStitched[faces(map.faceSource[i], j)];
+        }
+    }
+
+    int vertexOffset = numKeptVertices;
+    int faceOffset   = numKeptFaces;
+    for (const Submesh& patch : patches) {
+        const int numFrozen = patch.numFrozenVertices;
+        const int numActive = patch.vertices.rows() - numFrozen;
+
+        stitchedVertices.middleRows(vertexOffset, numActive) =
+            patch.vertices.bottomRows(numActive);
+
+        for (int i = 0; i < patch.faces.rows(); ++i) {
+            for (int j = 0; j < 3; ++j) {
+                int v = patch.faces(i, j);
+                stitchedFaces(faceOffset + i, j) =
+                    v < numFrozen
+                        ? parentToStitched[patch.parentVertexIdxs[v]]
+                        : vertexOffset + v - numFrozen;
+            }
+        }
+
+        vertexOffset += numActive;
+        faceOffset += patch.faces.rows();
+    }
+
+    return map;
+}
+
+}  // namespace locremesh
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <vector>
+
+#include "meshConnectivity.h"
+#include "selectionSet.h"
+
+namespace locremesh {
+
+/**
+ * A patch cut out of a larger mesh so that it can be remeshed on its own.
+ *
+ * The patch holds every face touching an active vertex. The remaining corners
+ * of those faces form a frozen ring that glues the patch back into the parent
+ * mesh. Frozen vertices always occupy the first numFrozenVertices local
+ * indices, so they keep their indices while the remesher appends and removes
+ * active vertices behind them.
+ */
+struct Submesh
+{
+    Eigen::MatrixXd vertices;
+    Eigen::MatrixXi faces;
+
+    // Local indices of the frozen vertices, in the form remesh_botsch expects
+    Eigen::VectorXi feature;
+
+    int numFrozenVertices = 0;
+
+    // Parent mesh indices of the vertices (frozen first, then active) and of
+    // the faces the patch was cut from
+    std::vector<int> parentVertexIdxs;
+    std::vector<int> parentFaceIdxs;
+};
+
+/**
+ * Maps the elements of a stitched mesh back to the mesh the patches were cut
+ * from. An entry of -1 marks an element created by the remesher.
+ */
+struct StitchMap
+{
+    std::vector<int> vertexSource;
+    std::vector<int> faceSource;
+};
+
+/**
+ * Cuts out the faces incident to the active vertices plus the frozen ring of
+ * vertices around them.
+ *
+ * @param vertices The vertices of the parent mesh.
+ * @param faces The faces of the parent mesh.
+ * @param connectivity The connectivity of the parent mesh.
+ * @param active The vertices the remesher may move, collapse or flip around.
+ * Only they and their faces are visited, so the cost scales with the size of
+ * the selection.
+ * @return The extracted patch.
+ */
+Submesh extractSubmesh(const Eigen::MatrixXd&  vertices,
+                       const Eigen::MatrixXi&  faces,
+                       const MeshConnectivity& connectivity,
+                       const SelectionSet&     active);
+
+/**
+ * Same as extractSubmesh(), with one patch per connected component of the
+ * active vertices. The patches share no faces and no active vertices, only
+ * frozen ones, so they can be remeshed independently and stitched back
+ * together with stitchSubmeshes().
+ */
+std::vector<Submesh> extractSubmeshes(const Eigen::MatrixXd&  vertices,
+                                      const Eigen::MatrixXi&  faces,
+                                      const MeshConnectivity& connectivity,
+                                      const SelectionSet&     active);
+
+/**
+ * Replaces the regions covered by the patches with their remeshed content.
+ *
+ * The faces outside all patches are kept in their original order, followed by
+ * the faces of each patch. Active parent vertices are dropped and the
+ * surviving vertices compacted, followed by the active vertices of each
+ * patch. Frozen vertices keep their parent positions so the seams stay
+ * watertight.
+ *
+ * @return The mapping of the stitched elements back to the parent mesh.
+ */
+StitchMap stitchSubmeshes(const Eigen::MatrixXd&      vertices,
+                          const Eigen::MatrixXi&      faces,
+                          const std::vector<Submesh>& patches,
+                          Eigen::MatrixXd&            stitchedVertices,
+                          Eigen::MatrixXi&            stitchedFaces);
+
+}  // namespace locremesh
@@ -0,0 +1,21 @@
+#include "botschRemesher.h"
+
+#include "polyscope/polyscope.h"
+
+namespace locremesh {
+
+void BotschRemesher::polyscopeUISection()
+{
+    ImGui::Text("Remeshing");
+    ImGui::SliderFloat("Target Edge Length", &m_targetEdgeLength, 0.01f, 1.f);
+    ImGui::SliderInt("Iterations", &m_iterations, 1, 100);
+    ImGui::Checkbox("Project resulting mesh onto the original",
+                    &m_shouldProject);
+    ImGui::Checkbox("Remesh selected region only", &m_localizedRemeshing);
+    ImGui::Checkbox("Adaptive target edge length", &m_useSizingField);
+    if (m_useSizingField) {
+        m_sizingField.polyscopeUISection();
+    }
+}
+
+}  // namespace locremesh
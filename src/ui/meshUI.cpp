@@ -0,0 +1,43 @@
+#include "mesh.h"
+
+#include "polyscope/surface_mesh.h"
+
+namespace locremesh {
+
+polyscope::SurfaceMesh* Mesh::polyscopeRegisterSurfaceMesh()
+{
+    assert(m_quality.size() == m_faces.rows());  // Quality has been calculated
+    assert(m_uvCoords.rows() == m_vertices.rows() && m_uvCoords.cols() == 2);
+
+    if (polyscope::hasSurfaceMesh(m_polyscopeID)) {
+        polyscope::removeSurfaceMesh(m_polyscopeID);
+    }
+
+    auto psSurfaceMesh =
+        polyscope::registerSurfaceMesh(m_polyscopeID, m_vertices, m_faces);
+
+    // Add Triangle Quality
+    auto psFaceScalar =
+        psSurfaceMesh->addFaceScalarQuantity("Triangle Quality", m_quality);
+    psFaceScalar->setMapRange(std::make_pair<int, int>(0, 1));
+
+    // Add Parametrization
+    auto psVertexParam =
+        psSurfaceMesh->addVertexParameterizationQuantity("UV Map", m_uvCoords);
+
+    // Add texture
+    if (m_textureColor && !m_textureColor->empty()) {
+        auto psTextureColor = psSurfaceMesh->addTextureColorQuantity(
+            "Texture",
+            *psVertexParam,
+            m_textureWidth,
+            m_textureHeight,
+            *m_textureColor,
+            polyscope::ImageOrigin::LowerLeft);
+        psTextureColor->setEnabled(true);
+    }
+
+    return psSurfaceMesh;
+}
+
+}  // namespace locremesh
@@ -0,0 +1,18 @@
+#include "sizingField.h"
+
+#include "polyscope/polyscope.h"
+
+namespace locremesh {
+
+void SizingField::polyscopeUISection()
+{
+    ImGui::SliderFloat("Curvature Tolerance", &m_curvatureTolerance, 0.001f,
+                       0.5f);
+    ImGui::SliderFloat("Strain Weight", &m_strainWeight, 0.f, 10.f);
+    ImGui::SliderFloat("Quality Weight", &m_qualityWeight, 0.f, 10.f);
+    ImGui::SliderFloat("Min Edge Length Scale", &m_minScale, 0.05f, 1.f);
+    ImGui::SliderFloat("Max Edge Length Scale", &m_maxScale, 1.f, 10.f);
+    ImGui::SliderFloat("Gradation", &m_gradation, 0.05f, 2.f);
+}
+
+}  // namespace locremesh
@@ -0,0 +1,146 @@
+#include "vertexSelector.h"
+
+#include <sstream>
+
+#include "polyscope/point_cloud.h"
+#include "polyscope/surface_mesh.h"
+
+namespace locremesh {
+
+void VertexSelector::polyscopeUpdatePointCloud()
+{
+    const std::vector<int>& selectedVertices = m_selection.getIndices();
+
+    if (selectedVertices.empty()) {
+        m_selectedVerticesStr = "None";
+    } else {
+        std::stringstream ss;
+        auto              it = selectedVertices.begin();
+        ss << *it;
+        for (++it; it != selectedVertices.end(); ++it) {
+            ss << ", " << *it;
+        }
+        m_selectedVerticesStr = ss.str();
+    }
+
+    if (polyscope::hasPointCloud(m_selectedVerticesPointCloudPSID)) {
+        polyscope::removePointCloud(m_selectedVerticesPointCloudPSID);
+    }
+    if (!selectedVertices.empty()) {
+        auto pc = polyscope::registerPointCloud(
+            m_selectedVerticesPointCloudPSID,
+            getMeshVerticesCoords(m_targetMesh.getVertices(),
+                                  selectedVertices));
+        pc->setEnabled(true);
+        pc->setPointColor({1.0, 0.0, 0.0});
+    }
+
+    m_wasSelectionModified = false;
+}
+
+void VertexSelector::handleManualVertexSelection(ImGuiIO& io)
+{
+    // ALT + Click to select a vertex
+    if (io.KeyAlt && io.MouseClicked[0]) {
+        glm::vec2             screenCoords{io.MousePos.x, io.MousePos.y};
+        polyscope::PickResult pickResult =
+            polyscope::pickAtScreenCoords(screenCoords);
+
+        auto targetSurfaceMesh =
+            polyscope::getSurfaceMesh(m_targetMesh.getPolyscopeID());
+
+        if (pickResult.isHit && pickResult.structure == targetSurfaceMesh) {
+            polyscope::SurfaceMeshPickResult meshPickResult =
+                targetSurfaceMesh->interpretPickResult(pickResult);
+
+            if (meshPickResult.elementType == polyscope::MeshElement::VERTEX) {
+                std::cout << "clicked vertex " << meshPickResult.index
+                          << std::endl;
+
+                m_selection.insert(meshPickResult.index);
+
+                if (!m_wasSelectionModified)
+                    m_wasSelectionModified = true;
+            }
+        }
+    }
+
+    // CTRL + Click to select all vertices of a face
+    if (io.KeyCtrl && io.MouseClicked[0]) {
+        glm::vec2             screenCoords{io.MousePos.x, io.MousePos.y};
+        polyscope::PickResult pickResult =
+            polyscope::pickAtScreenCoords(screenCoords);
+
+        auto targetSurfaceMesh =
+            polyscope::getSurfaceMesh(m_targetMesh.getPolyscopeID());
+
+        if (pickResult.isHit && pickResult.structure == targetSurfaceMesh) {
+            polyscope::SurfaceMeshPickResult meshPickResult =
+                targetSurfaceMesh->interpretPickResult(pickResult);
+
+            if (meshPickResult.elementType == polyscope::MeshElement::FACE) {
+                std::cout << "clicked face " << meshPickResult.index
+                          << std::endl;
+
+                Eigen::MatrixXi faces = m_targetMesh.getFaces();
+                m_selection.insert(faces(meshPickResult.index, 0));
+                m_selection.insert(faces(meshPickResult.index, 1));
+                m_selection.insert(faces(meshPickResult.index, 2));
+
+                if (!m_wasSelectionModified)
+                    m_wasSelectionModified = true;
+            }
+        }
+    }
+}
+
+void VertexSelector::polyscopeUISection()
+{
+    ImGui::Text("Vertex Selection");
+    // ImGui::SameLine();
+    // ImGui::TextDisabled("(help)");
+    // if (ImGui::IsItemHovered()) {
+    //     ImGui::BeginTooltip();
+    //     ImGui::PushTextWrapPos(ImGui::GetFontSize() * 35.0f);
+    //     ImGui::TextUnformatted("ALT+Click on a vertex to select it.");
+    //     ImGui::TextUnformatted(
+    //         "CTRL+Click on a face to select all its vertices.");
+    //     ImGui::PopTextWrapPos();
+    //     ImGui::EndTooltip();
+    // }
+
+    // if (ImGui::CollapsingHeader("Selected Vertices")) {
+    //     ImGui::TextWrapped("%s", m_selectedVerticesStr.c_str());
+    // }
+
+    // if (ImGui::Button("Select All")) {
+    //     for (int i = 0; i < m_targetMesh.getVertexCount(); ++i) {
+    //         m_selection.insert(i);
+    //     }
+    //     m_wasSelectionModified = true;
+    // }
+
+    // if (ImGui::Button("Apply One-Ring Dilation")) {
+    //     applyOneRingDilation();
+    // }
+
+    ImGui::SliderFloat(
+        "Quality Threshold", &m_qualityThreshold, 0.0f, 1.0f, "%.2f");
+    ImGui::SliderFloat(
+        "Quality Exit Margin", &m_qualityExitMargin, 0.0f, 0.5f, "%.2f");
+    ImGui::SliderInt("Remesh Cooldown", &m_remeshCooldown, 0, 20);
+    ImGui::SliderInt("Min Region Size", &m_minRegionSize, 1, 50);
+    ImGui::Checkbox("Incremental Selection", &m_incrementalSelection);
+
+    // if (ImGui::Button("Select Based on Quality")) {
+    //     selectVerticesBasedOnQuality();
+    // }
+
+    if (ImGui::Button("Clear Selection")) {
+        clearSelection();
+    }
+
+    ImGui::Separator();
+}
+
+}  // namespace locremesh
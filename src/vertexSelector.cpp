@@ -1,5 +1,8 @@
 #include "vertexSelector.h"
 
+#include <algorithm>
+#include <unordered_map>
+
 namespace locremesh {
 
 /**
@@ -9,206 +12,384 @@ namespace locremesh {
  */
 Eigen::VectorXi VertexSelector::extractFeatureFromSelection()
 {
-    std::set<int> verticesToIgnore;
+    const std::vector<char> isFeature = extractFeatureMaskFromSelection();
 
-    auto boundaryBitMask = m_targetMesh.getBoundaryBitMask();
-    for (int i = 0; i < m_selectionBitMask.size(); i++) {
-        if (!m_selectionBitMask[i] || boundaryBitMask[i]) {
-            verticesToIgnore.insert(i);
+    int numFeatures = 0;
+    for (char f : isFeature) {
+        numFeatures += f;
+    }
+    Eigen::VectorXi feature(numFeatures);
+    for (int i = 0, j = 0; i < isFeature.size(); i++) {
+        if (isFeature[i]) {
+            feature[j++] = i;
         }
     }
+    return feature;
+}
+
+/**
+ * Same as extractFeatureFromSelection() as one flag per vertex, the form
+ * remesh_botsch takes without any conversion.
+ */
+std::vector<char> VertexSelector::extractFeatureMaskFromSelection()
+{
+    const std::vector<bool>& boundaryBitMask =
+        m_targetMesh.getBoundaryBitMask();
 
-    Eigen::VectorXi feature(verticesToIgnore.size());
-    for (int i = 0; auto idx : verticesToIgnore) {
-        feature[i++] = idx;
+    std::vector<char> isFeature(m_targetMesh.getVertexCount(), 1);
+    for (int i : m_selection.getIndices()) {
+        isFeature[i] = boundaryBitMask[i];
     }
+    return isFeature;
+}
 
-    return feature;
+/**
+ * Complement of extractFeatureFromSelection(): the selected vertices the
+ * remesher is allowed to modify. Only the selection is visited.
+ */
+SelectionSet VertexSelector::extractActiveFromSelection()
+{
+    const std::vector<bool>& boundaryBitMask =
+        m_targetMesh.getBoundaryBitMask();
+
+    SelectionSet active(m_targetMesh.getVertexCount());
+    for (int i : m_selection.getIndices()) {
+        if (!boundaryBitMask[i]) {
+            active.insert(i);
+        }
+    }
+    return active;
 }
 
 void VertexSelector::clearSelection()
 {
-    m_selectionBitMask.assign(m_selectionBitMask.size(), false);
-    if (polyscope::hasPointCloud(m_selectedVerticesPointCloudPSID)) {
-        polyscope::removePointCloud(m_selectedVerticesPointCloudPSID);
-    }
+    m_selection.resize(m_targetMesh.getVertexCount());
     m_wasSelectionModified = true;
 }
 
 void VertexSelector::updateTargetMesh(Mesh& targetMesh)
 {
     m_targetMesh = targetMesh;
+    m_isQualitySelectedFace.clear();
     clearSelection();
 }
 
+/**
+ * Selects the vertices of the faces at or below the quality threshold, except
+ * for faces touching the boundary.
+ *
+ * The selection has some inertia, so that it does not flicker and trigger a
+ * remesh every step. A face enters it at m_qualityThreshold but only leaves it
+ * above m_qualityThreshold + m_qualityExitMargin, faces created by a remesh
+ * cannot enter it during m_remeshCooldown calls and regions of fewer than
+ * m_minRegionSize vertices are dropped. hasPendingSelection() tells whether
+ * the faces of the regions that are kept changed since the last remesh.
+ *
+ * The faces picked by the quality are remembered between calls, so when only
+ * some faces changed their quality since the last call, only those are
+ * evaluated again. Otherwise all faces are evaluated in parallel.
+ */
 void VertexSelector::selectVerticesBasedOnQuality()
 {
-    m_selectionBitMask.assign(m_targetMesh.getVertexCount(), false);
-    const Eigen::VectorXd& quality = m_targetMesh.getQuality();
-    const std::vector<bool>& boundaryBitMask = m_targetMesh.getBoundaryBitMask();
-    for (int i = 0; i < quality.size(); ++i) {
-        if (quality[i] <= m_qualityThreshold) {
-            auto face                   = m_targetMesh.getFaces().row(i);
-            if (!boundaryBitMask[face[0]] && !boundaryBitMask[face[1]] && !boundaryBitMask[face[2]]) {
- m_selectionBitMask[face[0]] = true;
- m_selectionBitMask[face[1]] = true;
- m_selectionBitMask[face[2]] = true;
-            }
-        }
+    const int numFaces = m_targetMesh.getFaceCount();
+    if (m_isQualitySelectedFace.size() != numFaces) {
+        m_isQualitySelectedFace.assign(numFaces, 0);
+        m_faceCooldown.assign(numFaces, 0);
+        m_coolingFaceIdxs.clear();
+        m_cooledFaceIdxs.clear();
+        m_selectedFaceIdxs.clear();
+        m_qualitySelection = SelectionSet();
+    }
+
+    const bool canUpdate =
+        m_incrementalSelection && !m_targetMesh.haveAllQualitiesChanged() &&
+        m_qualityThreshold == m_lastQualityThreshold &&
+        m_qualityExitMargin == m_lastQualityExitMargin &&
+        m_qualitySelection.getMaskSize() == m_targetMesh.getVertexCount();
+    if (canUpdate) {
+        updateQualitySelection();
+    } else {
+        computeQualitySelection();
+    }
+    m_targetMesh.clearQualityChanges();
+    advanceCooldown();
+    m_lastQualityThreshold  = m_qualityThreshold;
+    m_lastQualityExitMargin = m_qualityExitMargin;
+
+    // Only what is left after dropping the small regions gets remeshed, so
+    // only changes to that count
+    std::vector<int> selectedFaceIdxs = selectLargeRegions();
+    if (selectedFaceIdxs != m_selectedFaceIdxs) {
+        m_hasPendingSelection = true;
+        m_selectedFaceIdxs    = std::move(selectedFaceIdxs);
     }
     m_wasSelectionModified = true;
 }
 
-void VertexSelector::polyscopeUpdatePointCloud()
+/**
+ * Carries the state of the quality selection over to the faces of the
+ * remeshed mesh. Faces created by the remesher start deselected and cooling
+ * down, so that they get a chance to settle before being judged.
+ */
+void VertexSelector::notifyRemeshed(const StitchMap& map)
 {
-    // Clear previous data
-    std::set<int> selectedVertices;
-    for (int i = 0; i < m_selectionBitMask.size(); i++) {
-        if (m_selectionBitMask[i]) {
-            selectedVertices.insert(i);
+    const int         numFaces = map.faceSource.size();
+    const bool        hasState = !m_isQualitySelectedFace.empty();
+    std::vector<char> isQualitySelectedFace(numFaces, 0);
+    std::vector<int>  faceCooldown(numFaces, 0);
+    std::vector<int>  selectedFaceIdxs;
+    m_coolingFaceIdxs.clear();
+    m_cooledFaceIdxs.clear();
+    for (int f = 0; f < numFaces; ++f) {
+        const int source = map.faceSource[f];
+        if (source >= 0 && hasState) {
+            isQualitySelectedFace[f] = m_isQualitySelectedFace[source];
+            faceCooldown[f]          = m_faceCooldown[source];
+            if (std::binary_search(m_selectedFaceIdxs.begin(),
+                                   m_selectedFaceIdxs.end(),
+                                   source)) {
+                selectedFaceIdxs.push_back(f);
+            }
+        } else if (source < 0) {
+            faceCooldown[f] = m_remeshCooldown;
+        }
+        if (faceCooldown[f] > 0) {
+            m_coolingFaceIdxs.push_back(f);
         }
     }
+    m_isQualitySelectedFace = std::move(isQualitySelectedFace);
+    m_faceCooldown          = std::move(faceCooldown);
+    m_selectedFaceIdxs      = std::move(selectedFaceIdxs);
+    m_qualitySelection      = SelectionSet();
+}
 
-    if (selectedVertices.empty()) {
-        m_selectedVerticesStr = "None";
-    } else {
-        std::stringstream ss;
-        auto              it = selectedVertices.begin();
-        ss << *it;
-        for (++it; it != selectedVertices.end(); ++it) {
-            ss << ", " << *it;
+bool VertexSelector::isQualitySelectedFace(int faceIdx) const
+{
+    if (m_faceCooldown[faceIdx] > 0) {
+        return false;
+    }
+    const Eigen::MatrixXi&   faces = m_targetMesh.getFaces();
+    const std::vector<bool>& boundaryBitMask =
+        m_targetMesh.getBoundaryBitMask();
+    const double threshold = m_isQualitySelectedFace[faceIdx]
+                                 ? m_qualityThreshold + m_qualityExitMargin
+                                 : m_qualityThreshold;
+    return m_targetMesh.getQuality()[faceIdx] <= threshold &&
+           !boundaryBitMask[faces(faceIdx, 0)] &&
+           !boundaryBitMask[faces(faceIdx, 1)] &&
+           !boundaryBitMask[faces(faceIdx, 2)];
+}
+
+/**
+ * Counts down the cooldown of the faces created by the last remeshes. The
+ * faces whose cooldown ends are free to be selected again and are evaluated
+ * by the next incremental update.
+ */
+void VertexSelector::advanceCooldown()
+{
+    int numCooling = 0;
+    for (int f : m_coolingFaceIdxs) {
+        if (--m_faceCooldown[f] > 0) {
+            m_coolingFaceIdxs[numCooling++] = f;
+        } else {
+            m_cooledFaceIdxs.push_back(f);
         }
-        m_selectedVerticesStr = ss.str();
     }
+    m_coolingFaceIdxs.resize(numCooling);
+}
 
-    if (polyscope::hasPointCloud(m_selectedVerticesPointCloudPSID)) {
-        polyscope::removePointCloud(m_selectedVerticesPointCloudPSID);
+void VertexSelector::computeQualitySelection()
+{
+    const Eigen::MatrixXi& faces       = m_targetMesh.getFaces();
+    const int              numFaces    = faces.rows();
+    const int              numVertices = m_targetMesh.getVertexCount();
+    const int              numThreads  = m_targetMesh.getNumThreads();
+
+    // One byte per face, so every thread writes to its own entries only
+#pragma omp parallel for schedule(static) if (numThreads > 1) \
+    num_threads(numThreads)
+    for (int f = 0; f < numFaces; ++f) {
+        m_isQualitySelectedFace[f] = isQualitySelectedFace(f);
     }
-    if (!selectedVertices.empty()) {
-        auto pc = polyscope::registerPointCloud(
-            m_selectedVerticesPointCloudPSID,
-            getMeshVerticesCoords(m_targetMesh.getVertices(),
-                                  selectedVertices));
-        pc->setEnabled(true);
-        pc->setPointColor({1.0, 0.0, 0.0});
+    m_cooledFaceIdxs.clear();
+
+    m_numQualitySelectedFaces.assign(numVertices, 0);
+    m_qualitySelection.resize(numVertices);
+    for (int f = 0; f < numFaces; ++f) {
+        if (m_isQualitySelectedFace[f]) {
+            for (int k = 0; k < 3; ++k) {
+                m_numQualitySelectedFaces[faces(f, k)]++;
+                m_qualitySelection.insert(faces(f, k));
+            }
+        }
     }
-
-    m_wasSelectionModified = false;
 }
 
-void VertexSelector::handleManualVertexSelection(ImGuiIO& io)
+/**
+ * Re-evaluates the faces whose quality changed since the last selection or
+ * whose cooldown just ended. A vertex stays selected as long as one of its
+ * faces is.
+ */
+void VertexSelector::updateQualitySelection()
 {
-    // ALT + Click to select a vertex
-    if (io.KeyAlt && io.MouseClicked[0]) {
-        glm::vec2             screenCoords{io.MousePos.x, io.MousePos.y};
-        polyscope::PickResult pickResult =
-            polyscope::pickAtScreenCoords(screenCoords);
-
-        auto targetSurfaceMesh =
-            polyscope::getSurfaceMesh(m_targetMesh.getPolyscopeID());
-
-        if (pickResult.isHit && pickResult.structure == targetSurfaceMesh) {
-            polyscope::SurfaceMeshPickResult meshPickResult =
-                targetSurfaceMesh->interpretPickResult(pickResult);
+    const Eigen::MatrixXi& faces = m_targetMesh.getFaces();
 
-            if (meshPickResult.elementType == polyscope::MeshElement::VERTEX) {
-                std::cout << "clicked vertex " << meshPickResult.index
-                          << std::endl;
-
-                m_selectionBitMask[meshPickResult.index] = true;
-
-                if (!m_wasSelectionModified)
-                    m_wasSelectionModified = true;
+    auto update = [&](int f) {
+        const char isSelected = isQualitySelectedFace(f);
+        if (isSelected == m_isQualitySelectedFace[f]) {
+            return;
+        }
+        m_isQualitySelectedFace[f] = isSelected;
+        for (int k = 0; k < 3; ++k) {
+            const int v = faces(f, k);
+            m_numQualitySelectedFaces[v] += isSelected ? 1 : -1;
+            if (m_numQualitySelectedFaces[v] > 0) {
+                m_qualitySelection.insert(v);
+            } else {
+                m_qualitySelection.erase(v);
             }
         }
+    };
+    for (int f : m_targetMesh.getChangedQualityFaces()) {
+        update(f);
     }
+    for (int f : m_cooledFaceIdxs) {
+        update(f);
+    }
+    m_cooledFaceIdxs.clear();
+}
 
-    // CTRL + Click to select all vertices of a face
-    if (io.KeyCtrl && io.MouseClicked[0]) {
-        glm::vec2             screenCoords{io.MousePos.x, io.MousePos.y};
-        polyscope::PickResult pickResult =
-            polyscope::pickAtScreenCoords(screenCoords);
-
-        auto targetSurfaceMesh =
-            polyscope::getSurfaceMesh(m_targetMesh.getPolyscopeID());
-
-        if (pickResult.isHit && pickResult.structure == targetSurfaceMesh) {
-            polyscope::SurfaceMeshPickResult meshPickResult =
-                targetSurfaceMesh->interpretPickResult(pickResult);
-
-            if (meshPickResult.elementType == polyscope::MeshElement::FACE) {
-                std::cout << "clicked face " << meshPickResult.index
-                          << std::endl;
-
-                Eigen::MatrixXi faces = m_targetMesh.getFaces();
-                m_selectionBitMask[faces(meshPickResult.index, 0)] = true;
-                m_selectionBitMask[faces(meshPickResult.index, 1)] = true;
-                m_selectionBitMask[faces(meshPickResult.index, 2)] = true;
+/**
+ * Copies the regions of the quality selection with at least m_minRegionSize
+ * vertices into the selection. Regions are connected through the edges
+ * between selected vertices.
+ *
+ * @return The sorted selected faces of the regions that were kept.
+ */
+std::vector<int> VertexSelector::selectLargeRegions()
+{
+    const MeshConnectivity& connectivity = m_targetMesh.getConnectivity();
+    std::vector<int>        selectedFaceIdxs;
+    auto                    keepRegion = [&](const std::vector<int>& region) {
+        for (int v : region) {
+            m_selection.insert(v);
+            for (int f : connectivity.getVertexFaces(v)) {
+                if (m_isQualitySelectedFace[f]) {
+                    selectedFaceIdxs.push_back(f);
+                }
+            }
+        }
+    };
 
-                if (!m_wasSelectionModified)
-                    m_wasSelectionModified = true;
+    m_selection.resize(m_targetMesh.getVertexCount());
+    if (m_minRegionSize <= 1) {
+        keepRegion(m_qualitySelection.getIndices());
+    } else {
+        SelectionSet     visited(m_targetMesh.getVertexCount());
+        std::vector<int> region;
+        for (int seed : m_qualitySelection.getIndices()) {
+            if (visited.contains(seed)) {
+                continue;
+            }
+            region.assign(1, seed);
+            visited.insert(seed);
+            for (int r = 0; r < region.size(); ++r) {
+                const int v = region[r];
+                for (int neighborIdx : connectivity.getVertexNeighbors(v)) {
+                    if (m_qualitySelection.contains(neighborIdx) &&
+                        !visited.contains(neighborIdx)) {
+                        visited.insert(neighborIdx);
+                        region.push_back(neighborIdx);
+                    }
+                }
+            }
+            if (region.size() >= m_minRegionSize) {
+                keepRegion(region);
             }
         }
     }
+
+    std::sort(selectedFaceIdxs.begin(), selectedFaceIdxs.end());
+    selectedFaceIdxs.erase(
+        std::unique(selectedFaceIdxs.begin(), selectedFaceIdxs.end()),
+        selectedFaceIdxs.end());
+    return selectedFaceIdxs;
 }
 
-void VertexSelector::polyscopeUISection()
+void VertexSelector::applyOneRingDilation()
 {
-    ImGui::Text("Vertex Selection");
-    // ImGui::SameLine();
-    // ImGui::TextDisabled("(help)");
-    // if (ImGui::IsItemHovered()) {
-    //     ImGui::BeginTooltip();
-    //     ImGui::PushTextWrapPos(ImGui::GetFontSize() * 35.0f);
-    //     ImGui::TextUnformatted("ALT+Click on a vertex to select it.");
-    //     ImGui::TextUnformatted(
-    //         "CTRL+Click on a face to select all its vertices.");
-    //     ImGui::PopTextWrapPos();
-    //     ImGui::EndTooltip();
-    // }
-
-    // if (ImGui::CollapsingHeader("Selected Vertices")) {
-    //     ImGui::TextWrapped("%s", m_selectedVerticesStr.c_str());
-    // }
-
-    // if (ImGui::Button("Select All")) {
-    //     m_selectionBitMask.assign(m_targetMesh.getVertexCount(), true);
-    //     m_wasSelectionModified = true;
-    // }
-
-    // if (ImGui::Button("Apply One-Ring Dilation")) {
-    //     applyOneRingDilation();
-    // }
-
-    ImGui::SliderFloat(
-        "Quality Threshold", &m_qualityThreshold, 0.0f, 1.0f, "%.2f");
-
-    // if (ImGui::Button("Select Based on Quality")) {
-    //     selectVerticesBasedOnQuality();
-    // }
-
-    if (ImGui::Button("Clear Selection")) {
-        clearSelection();
-    }
-
-    ImGui::Separator();
+    dilate(1);
 }
 
-void VertexSelector::applyOneRingDilation()
+/**
+ * Grows the selection by up to numRings rings of neighbours, skipping the
+ * vertices farther than maxDistance from it. The search is a single
+ * breadth-first traversal starting from the current selection, and every ring
+ * only expands the vertices added by the previous one, so the cost scales
+ * with the size of the grown region rather than with the size of the mesh.
+ *
+ * Distances are only tracked along the rings, so a vertex is measured along
+ * the shortest path with as many edges as its ring. A vertex rejected in one
+ * ring may still be reached in a later one along a shorter path.
+ */
+void VertexSelector::dilate(int            numRings,
+                            double         maxDistance,
+                            DilationMetric metric)
 {
-    // For each selected vertex, identify all its neightbors and select them as
-    // well
-    std::vector<bool> newSelection = m_selectionBitMask;
-    for (int i = 0; i < m_selectionBitMask.size(); ++i) {
-        if (m_selectionBitMask[i]) {
-            // This vertex is selected, now select its neighbors
-            for (int neighborIdx : m_targetMesh.getVertexNeighbors(i)) {
-                newSelection[neighborIdx] = true;
+    const MeshConnectivity& connectivity = m_targetMesh.getConnectivity();
+    const Eigen::MatrixXd&  vertices     = m_targetMesh.getVertices();
+
+    struct FrontierVertex
+    {
+        int    idx;
+        int    sourceIdx;
+        double distance;
+    };
+
+    std::vector<FrontierVertex> frontier;
+    for (int i : m_selection.getIndices()) {
+        frontier.push_back({i, i, 0});
+    }
+
+    std::vector<FrontierVertex>  nextRing;
+    std::unordered_map<int, int> nextRingSlots;
+    for (int ring = 0; ring < numRings && !frontier.empty(); ++ring) {
+        nextRing.clear();
+        nextRingSlots.clear();
+        for (const FrontierVertex& v : frontier) {
+            for (int neighborIdx : connectivity.getVertexNeighbors(v.idx)) {
+                if (m_selection.contains(neighborIdx)) {
+                    continue;
+                }
+                const double distance =
+                    metric == DilationMetric::Geodesic
+                        ? v.distance + (vertices.row(neighborIdx) -
+                                        vertices.row(v.idx))
+                                           .norm()
+                        : (vertices.row(neighborIdx) -
+                           vertices.row(v.sourceIdx))
+                              .norm();
+                if (distance > maxDistance) {
+                    continue;
+                }
+
+                auto [it, isNew] =
+                    nextRingSlots.try_emplace(neighborIdx, nextRing.size());
+                if (isNew) {
+                    nextRing.push_back({neighborIdx, v.sourceIdx, distance});
+                } else if (distance < nextRing[it->second].distance) {
+                    nextRing[it->second] = {neighborIdx, v.sourceIdx, distance};
+                }
             }
         }
+
+        for (const FrontierVertex& v : nextRing) {
+            m_selection.insert(v.idx);
+        }
+        std::swap(frontier, nextRing);
     }
-    m_selectionBitMask     = newSelection;
+
     m_wasSelectionModified = true;
 }
 
-};  // namespace locremesh
\ No newline at end of file
+};  // namespace locremesh
@@ -2,36 +2,59 @@
 
 #include <Eigen/Core>
 #include <iostream>
+#include <limits>
 
 #include "igl/boundary_loop.h"
 #include "igl/igl_inline.h"
 #include "igl/read_triangle_mesh.h"
-#include "polyscope/point_cloud.h"
-#include "polyscope/surface_mesh.h"
 #include "remesh/src/remesh_botsch.h"
 
 #include "mesh.h"
+#include "selectionSet.h"
+
+struct ImGuiIO;
 
 namespace locremesh {
 
+/**
+ * How dilate() measures the distance of a vertex from the selection it grows
+ * from.
+ */
+enum class DilationMetric
+{
+    // Length of the shortest edge path found by the ring-by-ring search
+    Geodesic,
+    // Straight-line distance to the originally selected vertex the path
+    // started from
+    Euclidean
+};
+
 class VertexSelector
 {
    public:
     VertexSelector(Mesh& targetMesh, float qualityThreshold=0.4) : m_targetMesh(targetMesh),
     m_qualityThreshold(qualityThreshold)
     {
-        m_selectionBitMask.assign(m_targetMesh.getVertexCount(), false);
+        m_selection.resize(m_targetMesh.getVertexCount());
     }
 
     void applyOneRingDilation();
+    void dilate(
+        int            numRings,
+        double         maxDistance = std::numeric_limits<double>::infinity(),
+        DilationMetric metric      = DilationMetric::Geodesic);
     void selectVerticesBasedOnQuality();
+    void notifyRemeshed(const StitchMap& map);
+    // Defined in ui/, which only the viewer is built with
     void polyscopeUpdatePointCloud();
     void handleManualVertexSelection(ImGuiIO& io);
     void polyscopeUISection();
     void clearSelection();
     void updateTargetMesh(Mesh& targetMesh);
 
-    Eigen::VectorXi extractFeatureFromSelection();
+    Eigen::VectorXi   extractFeatureFromSelection();
+    std::vector<char> extractFeatureMaskFromSelection();
+    SelectionSet      extractActiveFromSelection();
 
     // Get methods -------------------------------------------------------------
     Mesh& getTargetMesh()
@@ -50,31 +73,88 @@ class VertexSelector
     {
         return m_selectedVerticesStr;
     }
+    bool hasPendingSelection() const
+    {
+        return m_hasPendingSelection;
+    }
     bool getWasSelectionModified() const
     {
         return m_wasSelectionModified;
     }
-    std::vector<bool>& getSelectedVerticesBitMask()
+    SelectionSet& getSelection()
     {
-        return m_selectionBitMask;
+        return m_selection;
     }
-    const std::vector<bool>& getSelectedVerticesBitMask() const
+    const SelectionSet& getSelection() const
     {
-        return m_selectionBitMask;
+        return m_selection;
     }
 
     void setWasSelectionModified(bool wasSelectionModified)
     {
         m_wasSelectionModified = wasSelectionModified;
     }
+    void setIncrementalSelection(bool incrementalSelection)
+    {
+        m_incrementalSelection = incrementalSelection;
+    }
+    void setQualityExitMargin(float qualityExitMargin)
+    {
+        m_qualityExitMargin = qualityExitMargin;
+    }
+    void setRemeshCooldown(int remeshCooldown)
+    {
+        m_remeshCooldown = remeshCooldown;
+    }
+    void setMinRegionSize(int minRegionSize)
+    {
+        m_minRegionSize = minRegionSize;
+    }
+    void clearPendingSelection()
+    {
+        m_hasPendingSelection = false;
+    }
 
    private:
+    bool             isQualitySelectedFace(int faceIdx) const;
+    void             advanceCooldown();
+    void             computeQualitySelection();
+    void             updateQualitySelection();
+    std::vector<int> selectLargeRegions();
+
     Mesh&             m_targetMesh;
     std::string       m_selectedVerticesPointCloudPSID = "selectedVertices";
     std::string       m_selectedVerticesStr;
     bool              m_wasSelectionModified = false;
-    std::vector<bool> m_selectionBitMask;
+    SelectionSet      m_selection;
     float             m_qualityThreshold;
+
+    // Selected faces stay selected up to m_qualityThreshold plus this margin
+    float             m_qualityExitMargin = 0.05f;
+    // Number of selections during which faces created by a remesh cannot be
+    // selected
+    int               m_remeshCooldown = 3;
+    // Smaller regions of the quality selection are left alone
+    int               m_minRegionSize = 1;
+    // Whether the selection changed since the last remesh, judged by the
+    // sorted selected faces of the regions that are kept
+    bool              m_hasPendingSelection = false;
+    std::vector<int>  m_selectedFaceIdxs;
+
+    // State of selectVerticesBasedOnQuality() kept for the incremental
+    // update and the hysteresis: the selected faces, the number of those
+    // around every vertex and the vertices with at least one of them
+    bool              m_incrementalSelection = true;
+    float             m_lastQualityThreshold  = -1.f;
+    float             m_lastQualityExitMargin = -1.f;
+    std::vector<char> m_isQualitySelectedFace;
+    std::vector<int>  m_numQualitySelectedFaces;
+    SelectionSet      m_qualitySelection;
+    // Remaining cooldown of every face, the faces where it is not zero and
+    // the ones where it ran out since the last update
+    std::vector<int>  m_faceCooldown;
+    std::vector<int>  m_coolingFaceIdxs;
+    std::vector<int>  m_cooledFaceIdxs;
 };
 
 }  // namespace locremesh
\ No newline at end of file